@@ -0,0 +1,58 @@
+#ifndef INCLUDE_LANE_FOLLOWING_BIT_MASK_H_
+#define INCLUDE_LANE_FOLLOWING_BIT_MASK_H_
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/mat.inl.hpp>
+#include <opencv2/core/types.hpp>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Binary mask packed one bit per pixel. Column x of a row is bit x % 64 of
+// word x / 64 (bit x % 8 of byte x / 8 on the little-endian targets we run
+// on), rows are padded with zero bits to whole words.
+class BitMask {
+public:
+	BitMask() :
+			rows(0), cols(0), wordsPerRow(0) {
+	}
+	// Allocates a cleared mask, keeps the buffer when the size is unchanged
+	void create(cv::Size size);
+	void release();
+	void swap(BitMask &other) {
+		std::swap(rows, other.rows);
+		std::swap(cols, other.cols);
+		std::swap(wordsPerRow, other.wordsPerRow);
+		words.swap(other.words);
+	}
+	bool empty() const {
+		return words.empty();
+	}
+	cv::Size size() const {
+		return cv::Size(cols, rows);
+	}
+	int getWordsPerRow() const {
+		return wordsPerRow;
+	}
+	uint64_t* row(int y) {
+		return words.data() + (size_t) y * wordsPerRow;
+	}
+	const uint64_t* row(int y) const {
+		return words.data() + (size_t) y * wordsPerRow;
+	}
+	// From / to an 8-bit mask, any non-zero byte is set
+	void Pack(const cv::Mat &mask);
+	void PackRows(const cv::Mat &mask, cv::Range rowRange);
+	void Unpack(cv::Mat &mask) const;
+	// dst = sat | (sobelx & red), word by word
+	static void Comb(const BitMask &sat, const BitMask &sobelx,
+			const BitMask &red, BitMask &dst);
+	int CountNonZero() const;
+private:
+	int rows;
+	int cols;
+	int wordsPerRow;
+	std::vector<uint64_t> words;
+};
+
+#endif /* INCLUDE_LANE_FOLLOWING_BIT_MASK_H_ */
@@ -0,0 +1,24 @@
+#ifndef INCLUDE_LANE_FOLLOWING_CALIBRATION_H_
+#define INCLUDE_LANE_FOLLOWING_CALIBRATION_H_
+
+#include <opencv2/core/types.hpp>
+#include <cstdint>
+#include <string>
+
+// Camera mounting calibration, the road trapezoid that maps onto the lane
+// band of the bird's-eye view in input pixels. Defaults match the original
+// camera.
+struct Calibration {
+	int posXLower;
+	int posYLower;
+	int posXUpper;
+	int posYUpper;
+	int centerLower;
+	int centerUpper;
+	Calibration();
+	bool Load(const std::string& fileName);
+	void getSrc(cv::Point2f src[4]) const;
+	uint64_t Hash() const;
+};
+
+#endif /* INCLUDE_LANE_FOLLOWING_CALIBRATION_H_ */
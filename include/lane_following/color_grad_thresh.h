@@ -3,26 +3,86 @@
 
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/mat.inl.hpp>
+#include <memory>
+#include <vector>
 
+#include "color_lut.h"
 #include "lane_base.h"
 
 class ColorGradThresh: public ColorGradThreshBase {
 public:
+	enum {
+		FUSED_STRIP_ROWS = 16, // Strip working set stays within L2
+		SOBEL_MAX = 1020 // Largest |g| of a 3x3 Sobel of 8-bit input
+	};
 	ColorGradThresh(int pipelineInstanceNum, bool bParallel, bool bGpuAccel,
 			bool bVerbose);
 	virtual ~ColorGradThresh();
 	virtual void Init() override;
 	virtual void Deinit() override;
 	virtual void setParams(LaneBase* obj) override;
+	// Scratch planes of one thresholded strip
+	struct Strip {
+		cv::Mat bgr;
+		cv::Mat red;
+		cv::Mat lig;
+		cv::Mat sat;
+		cv::Mat sobelx;
+		cv::Mat absSobelx;
+		cv::Mat threshRed;
+		cv::Mat threshSat;
+		cv::Mat threshSobelx;
+		cv::Mat mask;
+		// 255 * |g| / gradTabMax of every |g|, rebuilt when the maximum
+		// changes
+		std::vector<uchar> gradTab;
+		int gradTabMax;
+		// Largest |g| thresholded since the last reset, -1 when none
+		int sobelMax;
+		Strip() :
+				gradTabMax(0), sobelMax(-1) {
+		}
+		void Attach(MatArena &arena) {
+			arena.Attach( { &bgr, &red, &lig, &sat, &sobelx, &absSobelx,
+					&threshRed, &threshSat, &threshSobelx, &mask });
+		}
+	};
+	// With bGradNorm the gradient is scaled to gradMax, or saturated while
+	// there is none, and strip.sobelMax tracks the strip's own maximum
+	static void ThreshStrip(const cv::Mat &bgr, int haloTop, int haloBottom,
+			const Thresholds &thresh, Strip &strip, cv::Mat dst,
+			const ColorLut* colorLut = nullptr,
+			int sideBorder = cv::BORDER_CONSTANT, bool bGradNorm = false,
+			int gradMax = 0);
 protected:
 	virtual void SplitChannel(SPLIT_MODE mode) override;
 	virtual void CvtBGR2HLS() override;
 	virtual void ThresholdBinary(THRESH_MODE mode) override;
 	virtual void Sobelx() override;
 	virtual void AbsSobelx() override;
+	virtual void GradThresh() override;
 	virtual void CombBinaries() override;
+	virtual void FusedThresh() override;
+	virtual void SparseThresh() override;
+	virtual void ThreshBand(cv::Range rows, int band) override;
 private:
-	cv::Mat hls;
+	std::shared_ptr<const WarpMaps> warpMaps;
+	std::shared_ptr<const ColorLut> colorLut;
+	cv::Point2f src[4];
+	struct Camera {
+		cv::Mat lig;
+		cv::Mat sat;
+		cv::Mat red;
+		cv::Mat sobelx;
+		std::vector<int> rowStart;
+		std::vector<short> xs;
+	} camera;
+	Strip strip;
+	// Scratch of each row band, bands run concurrently
+	std::vector<Strip> bandStrips;
+	// Gradient maximum strips scale to with bGradNorm, that of the last
+	// frame this instance thresholded, 0 before the first
+	int gradMax;
 	struct Binaries {
 		cv::Mat threshRed;
 		cv::Mat threshSat;
@@ -35,7 +95,24 @@ private:
 			threshSobelx.release();
 		}
 	} binarySrc, binaryDst;
-	void Threshold(const cv::Mat &src, int lowerb, int upperb, cv::Mat &dst);
+	struct {
+		BitMask red;
+		BitMask sat;
+		BitMask sobelx;
+	} bits;
+	// Warp and threshold rows strip by strip
+	void FusedRows(cv::Range rows, Strip &strip, Histograms* hist);
+	// Lane prior mode, rows thresholded around the predicted lanes only
+	void PriorRows(cv::Range rows, Strip &strip, Histograms* hist);
+	void ThreshRect(cv::Range rows, cv::Range cols, Strip &strip,
+			Histograms* hist);
+	void SampleStrip(const Strip &strip, int haloTop, int firstRow,
+			Histograms &hist) const;
+	// What a full-image Sobel reads past the band's side columns
+	int getSideBorder() const {
+		return geometry.margin > 0 ?
+				cv::BORDER_CONSTANT : cv::BORDER_REFLECT_101;
+	}
 };
 
 #endif /* INCLUDE_LANE_FOLLOWING_COLOR_GRAD_THRESH_H_ */
@@ -0,0 +1,44 @@
+#ifndef INCLUDE_LANE_FOLLOWING_COLOR_LUT_H_
+#define INCLUDE_LANE_FOLLOWING_COLOR_LUT_H_
+
+#include <opencv2/core/hal/interface.h>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/mat.inl.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+// Color classification table of the threshold stage. The red test depends
+// on red only, lightness and the saturation test on the (max, min) channel
+// pair only, so one 64K entry table indexed by max * 256 + min plus a 256
+// entry red table answer all three exactly with one lookup each, and stay
+// cache-resident where a table indexed by the BGR triple would not. Built
+// once per red/saturation thresholds and shared read-only.
+class ColorLut {
+public:
+	ColorLut(const int red[2], const int sat[2]);
+	static std::shared_ptr<const ColorLut> Get(const int red[2],
+			const int sat[2]);
+	// Lightness plane and saturation / red threshold masks of a BGR image,
+	// the same as LigSatRed followed by InRange
+	void Apply(const cv::Mat &bgr, cv::Mat &lig, cv::Mat &satMask,
+			cv::Mat &redMask) const;
+private:
+	// Lightness in the low byte, saturation mask in the high byte
+	std::vector<ushort> ligSat;
+	uchar redTab[256];
+
+	typedef std::tuple<int, int, int, int> Key;
+	enum {
+		// The threshold controller moves only the thresholds it has
+		// histograms for, red and saturation have none while the table
+		// classifies them, so a run needs a single table
+		MAX_CACHED = 1
+	};
+	static std::map<Key, std::shared_ptr<const ColorLut>> cache;
+	static std::mutex cacheLock;
+};
+
+#endif /* INCLUDE_LANE_FOLLOWING_COLOR_LUT_H_ */
@@ -58,6 +58,22 @@ public:
 		}
 		return true;
 	}
+	bool hasCompleted() {
+		for (auto it = begin(); it != end(); it++) {
+			if (it->taskState == TASK_STATE_COMPLETED) {
+				return true;
+			}
+		}
+		return false;
+	}
+	bool contains(int procStep) {
+		for (auto it = begin(); it != end(); it++) {
+			if (it->procStep == procStep) {
+				return true;
+			}
+		}
+		return false;
+	}
 	bool NeedToRun() {
 		for (auto it = begin(); it != end(); it++) {
 			if (it->taskState == TASK_STATE_INITIALIZED) {
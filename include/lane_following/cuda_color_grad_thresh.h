@@ -19,6 +19,7 @@ protected:
 	virtual void ThresholdBinary(THRESH_MODE mode) override;
 	virtual void Sobelx() override;
 	virtual void AbsSobelx() override;
+	virtual void GradThresh() override;
 	virtual void CombBinaries() override;
 private:
 	cv::cuda::GpuMat gpuImg;
@@ -17,19 +17,32 @@ public:
 		Deinit();
 	}
 	virtual void Init() override {
-		gpuImg = cv::cuda::GpuMat(frameImg);
+		// Device buffers are kept across frames, upload reuses them
+		gpuImg.upload(frameImg);
 		WarpBase::Init();
 	}
 	virtual void Deinit() override {
-		gpuImg.release();
-		gpuOutImg.release();
 		WarpBase::Deinit();
 	}
 	cv::cuda::GpuMat& getOutImg() {
 		return gpuOutImg;
 	}
-	virtual void RunWarp() override {
-		cv::cuda::warpPerspective(gpuImg, gpuOutImg, perspTf, gpuImg.size());
+	virtual void RunWarp(cv::Range rows) override {
+		cv::Rect band = geometry.getBand();
+		for (const RowSegment &segment : getRowSegments(rows)) {
+			cv::cuda::GpuMat segmentImg = gpuOutImg(
+					cv::Rect(band.x, segment.rows.start, band.width,
+							segment.rows.size()));
+			cv::cuda::warpPerspective(gpuImg, segmentImg, segment.tf,
+					segmentImg.size());
+		}
+	}
+protected:
+	virtual void PrepWarp() override {
+		gpuOutImg.create(geometry.getSize(), gpuImg.type());
+		if (geometry.getBand().x > 0) {
+			gpuOutImg.setTo(cv::Scalar::all(0));
+		}
 	}
 private:
 	cv::cuda::GpuMat gpuImg;
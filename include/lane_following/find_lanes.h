@@ -7,8 +7,13 @@
 #include <memory>
 #include <vector>
 
+#include "bit_mask.h"
+#include "color_grad_thresh.h"
 #include "debug.h"
 #include "lane_base.h"
+#include "quad_fit.h"
+#include "row_index.h"
+#include "row_prefix.h"
 
 class ThreadBase;
 struct ThreadMsg;
@@ -18,11 +23,15 @@ public:
 	enum LANE_MODE {
 		LANE_MODE_LEFT, LANE_MODE_RIGHT
 	};
+	enum {
+		PRIOR_MIN_WINDOWS = 8, // re-centred bands to keep a prior search
+		PRIOR_MAX_SHIFT = 50 // fit change at the top or bottom, in pixels
+	};
 	enum PROC_STEP {
-		PROC_STEP_FIND_NONZERO,
-		PROC_STEP_HISTOGRAM,
+		PROC_STEP_FIND_NONZERO, // row index and histogram in one pass
 		PROC_STEP_PREP_OUT_IMG,
 #if DEBUG_ZONE_ALL_PROC_STEPS
+		PROC_STEP_HISTOGRAM,
 		PROC_STEP_WINDOW_SEARCH_LEFT,
 		PROC_STEP_CALC_POLY_LEFT,
 		PROC_STEP_WINDOW_SEARCH_RIGHT,
@@ -30,6 +39,7 @@ public:
 #endif
 		PROC_STEP_LEFT_LANE,
 		PROC_STEP_RIGHT_LANE,
+		PROC_STEP_BOTH_LANES, // left and right windows in one sweep
 		PROC_STEP_MAKE_OUT_IMG,
 		PROC_STEP_STEERING
 	};
@@ -84,20 +94,55 @@ public:
 	void setLaneHistory(const LaneHistory& laneHistory) {
 		this->laneHistory = laneHistory;
 	}
+	void setRefine(bool bRefine) {
+		this->bRefine = bRefine;
+	}
+	// Window statistics from per-row prefix sums instead of the row index
+	void setPrefixSearch(bool bPrefix) {
+		this->bPrefix = bPrefix;
+	}
+	// Search both lanes in one task instead of one task per lane
+	void setDualSearch(bool bDualSearch) {
+		this->bDualSearch = bDualSearch;
+	}
+	// Search around the previous fits while the lanes are tracked
+	void setPriorSearch(bool bPriorSearch) {
+		this->bPriorSearch = bPriorSearch;
+	}
+	// Fits of the tracked lanes in full resolution uniform coordinates,
+	// bPrior = false searches from scratch. The split debug steps always
+	// search from scratch.
+	void setLanePrior(bool bPrior, const std::vector<float>& leftFit,
+			const std::vector<float>& rightFit) {
+		this->bPrior = bPriorSearch && bPrior && leftFit.size() == 3
+				&& rightFit.size() == 3 && !DEBUG_ZONE_ALL_PROC_STEPS;
+		priorFit[0] = leftFit;
+		priorFit[1] = rightFit;
+	}
 	bool isDetected() const {
 		return bDetected;
 	}
 private:
-	cv::Mat img;
-	cv::Mat warpImg;
+	BitMask mask;
+	cv::Size searchSize; // mask resolution, reduced in pyramid mode
+	cv::Size imgSize; // full resolution, fits and overlay
 	cv::Mat outImg;
 	std::vector<cv::Point> nonzero;
+	RowIndex rowIndex;
+	RowPrefix rowPrefix;
 	std::vector<int> histogram;
 	long int frameDuration;
 	double speed;
 	double steeringAngle;
 	double maxSpeed;
 	bool bDetected;
+	bool bRefine;
+	bool bPrefix;
+	bool bDualSearch;
+	bool bPriorSearch;
+	bool bPrior;
+	std::vector<float> priorFit[2];
+	ColorGradThreshBase::Thresholds thresh;
 	LaneHistory laneHistory;
 	struct Hyperparams {
 		int windowsNum;
@@ -113,24 +158,59 @@ private:
 	} hyperparams;
 	struct LaneCurrent: public Line {
 		std::vector<cv::Point> pts;
+		// Fit moments of pts, gathered as they are found
+		QuadFit moments;
 		std::vector<cv::Point> fittedPts;
+		std::vector<cv::Rect> windows;
+		// FindBase column counts, per line as both lines search at once
+		std::vector<int> baseHist;
 		cv::Mat outImg;
-		virtual void clear() {
+		// Full resolution refinement scratch
+		ColorGradThresh::Strip strip;
+		cv::Mat refineMask;
+		void AddPt(const cv::Point& pt) {
+			pts.push_back(pt);
+			moments.Add(pt.x, pt.y);
+		}
+		void ClearPts() {
 			pts.clear();
+			moments.clear();
+		}
+		virtual void clear() {
+			ClearPts();
 			fittedPts.clear();
+			windows.clear();
 			outImg.release();
 			Line::clear();
 		}
 	} leftLine, rightLine;
+	void BuildGraph();
 	void FindNonZero();
 	void PrepOutImg();
 	void MakeOutImg();
 	void Histogram();
+	// Prior search with fallback, then the fits of the lines found
+	void SearchLanes(LaneCurrent* lines[], int linesNum);
+	// Band centroids of the pixels within the margin of the prior fits
+	void PriorSearch(LaneCurrent* lines[], int linesNum);
+	// Histogram peak of the line's half of the road, for a lost line
+	void FindBase(LaneCurrent& line);
 	void WindowSearch(LANE_MODE mode);
+	// Windows of up to two lines advance together band by band
+	void WindowSearch(LaneCurrent* lines[], int linesNum);
+	// Pixels in each line's window over rows and the sums of their
+	// coordinates, empty column ranges are skipped
+	void WindowStats(cv::Range rows, const cv::Range cols[], int linesNum,
+			int num[], int sumX[], int sumY[]) const;
+	void ColumnHistogram(cv::Range rows, std::vector<int>& hist) const;
+	void RefineCentroid(LaneCurrent& line, const cv::Rect& window,
+			cv::Point& pt);
 	void CalcPoly(LANE_MODE mode, bool bPredicted);
 	void PlotPoly(LANE_MODE mode, bool bPredicted);
-	void FitPoly(const cv::Mat& src_x, const cv::Mat& src_y, cv::Mat& dst,
-			int order);
+	void ProjectPts(const std::vector<cv::Point>& src,
+			std::vector<cv::Point>& dst);
+	void PlotProjected(const std::vector<cv::Point>& pts, bool bClosed,
+			const cv::Scalar& color, int thickness);
 	void Steering();
 };
 
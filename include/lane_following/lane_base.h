@@ -4,15 +4,25 @@
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/mat.inl.hpp>
 #include <opencv2/core/types.hpp>
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
+#include "bit_mask.h"
+#include "calibration.h"
 #include "completed_item.h"
 #include "debug.h"
+#include "mat_arena.h"
+#include "step_graph.h"
 #include "thread_base.h"
 #include "time_profiling.h"
+#include "warp_geometry.h"
+#include "warp_maps.h"
+
+class ThreshController;
 
 class LaneBase: public MsgObj, public TimeProfiling {
 public:
@@ -45,20 +55,27 @@ public:
 	virtual cv::Mat& getInvPerspTf() {
 		return invPerspTf;
 	}
+	const WarpGeometry& getGeometry() const {
+		return geometry;
+	}
 	std::chrono::system_clock::time_point& getStartTime() {
 		return startTime;
 	}
+	const MatArena& getArena() const {
+		return arena;
+	}
 	void setFrameIndex(int frameIndex) {
 		this->frameIndex = frameIndex;
 	}
 	void setProcStep(int procStep) {
 		this->procStep = procStep;
 	}
+	// Shared, not copied, see frameImg
 	void setFrameImg(cv::Mat& frameImg) {
-		this->frameImg = frameImg.clone();
+		this->frameImg = frameImg;
 	}
 	void setInvPerspTf(cv::Mat& invPerspTf) {
-		this->invPerspTf = invPerspTf.clone();
+		this->invPerspTf = invPerspTf;
 	}
 	void setStartTime(std::chrono::system_clock::time_point& startTime) {
 		this->startTime = startTime;
@@ -66,8 +83,13 @@ public:
 
 	CompletedItemList completedItemList;
 protected:
+	// Buffers of this instance, outlives every Mat attached to it
+	MatArena arena;
+	// Handed from stage to stage by reference and never written, a stage
+	// that needs to change them writes a new Mat instead
 	cv::Mat frameImg;
 	cv::Mat invPerspTf;
+	WarpGeometry geometry;
 	std::string moduleName;
 	int pipelineInstanceNum;
 	bool bParallel;
@@ -76,6 +98,8 @@ protected:
 	int frameIndex;
 	int procStep;
 	TASK_STATE taskState;
+	// Sub-steps and their inputs, declared once per configuration
+	StepGraph graph;
 	std::chrono::system_clock::time_point startTime;
 private:
 	std::recursive_mutex timestampsLock;
@@ -84,7 +108,11 @@ private:
 class WarpBase: public LaneBase {
 public:
 	enum PROC_STEP {
-		PROC_STEP_WARP
+		PROC_STEP_WARP,
+		PROC_STEP_WARP_BAND // + band index, one item per output row band
+	};
+	enum {
+		MAX_WARP_BANDS = 16
 	};
 	WarpBase(int pipelineInstanceNum, bool bParallel, bool bGpuAccel,
 			bool bVerbose);
@@ -96,10 +124,53 @@ public:
 	virtual void Process(std::shared_ptr<ThreadMsg> &msg, ThreadBase* thread)
 			override;
 	const virtual char* getProcStepString(int proc_step) override;
+	void setRemap(bool bRemap) {
+		this->bRemap = bRemap;
+	}
+	void setCalibration(const Calibration& calibration) {
+		this->calibration = calibration;
+	}
+	void setMapCacheFile(const std::string& mapCacheFile) {
+		this->mapCacheFile = mapCacheFile;
+	}
+	void setGeometry(const WarpGeometry& requestedGeometry) {
+		this->requestedGeometry = requestedGeometry;
+	}
+	void setFused(bool bFused) {
+		this->bFused = bFused;
+	}
+	void setSparse(bool bSparse) {
+		this->bSparse = bSparse;
+	}
+	void setBandsNum(int bandsNum) {
+		this->bandsNum = std::max(1, std::min(bandsNum, (int) MAX_WARP_BANDS));
+	}
+	virtual void RunWarp(cv::Range rows) = 0;
+	struct RowSegment {
+		cv::Range rows;
+		cv::Mat tf;
+	};
+	std::vector<RowSegment> getRowSegments(cv::Range rows) const;
+	const std::shared_ptr<const WarpMaps>& getWarpMaps() const {
+		return warpMaps;
+	}
+	const cv::Point2f* getSrc() const {
+		return src;
+	}
 protected:
 	cv::Mat perspTf;
+	cv::Mat bandPerspTf;
 	cv::Point2f src[4], dst[4];
-	virtual void RunWarp() = 0;
+	cv::Size tfSize;
+	Calibration calibration;
+	std::string mapCacheFile;
+	WarpGeometry requestedGeometry;
+	bool bRemap;
+	bool bFused;
+	bool bSparse;
+	int bandsNum;
+	std::shared_ptr<const WarpMaps> warpMaps;
+	virtual void PrepWarp() = 0;
 };
 
 class ColorGradThreshBase: public LaneBase {
@@ -118,12 +189,50 @@ public:
 		PROC_STEP_SPLIT_HLS,
 		PROC_STEP_THRESH_RED,
 		PROC_STEP_THRESH_SAT,
-		PROC_STEP_SOBEL_X,
 #if DEBUG_ZONE_ALL_PROC_STEPS
+		PROC_STEP_SOBEL_X,
 		PROC_STEP_ABS_SOBEL_X,
-#endif
 		PROC_STEP_THRESH_SOBEL_X,
-		PROC_STEP_COMB_THRESH
+#else
+		PROC_STEP_GRAD_THRESH, // Sobel, abs and threshold in one pass
+#endif
+		PROC_STEP_COMB_THRESH,
+		PROC_STEP_FUSED_THRESH,
+		PROC_STEP_SPARSE_THRESH,
+		PROC_STEP_THRESH_BAND // + band index, one item per output row band
+	};
+	enum {
+		MAX_THRESH_BANDS = 16,
+		// Columns kept on each side of a predicted lane, the window margin
+		// plus the lane motion since the prior frame
+		PRIOR_MARGIN = 150
+	};
+	struct Thresholds {
+		int red[2];
+		int sat[2];
+		int sobelx[2];
+	};
+	// Channel value histograms of every HIST_ROW_STEP-th mask row, for the
+	// threshold controller
+	struct Histograms {
+		enum {
+			HIST_ROW_STEP = 4
+		};
+		int red[256];
+		int sat[256];
+		int sobelx[256];
+		void clear() {
+			std::fill(red, red + 256, 0);
+			std::fill(sat, sat + 256, 0);
+			std::fill(sobelx, sobelx + 256, 0);
+		}
+		void Add(const Histograms &d);
+		// 8-bit plane, row 0 is the first mask row of the plane
+		static void Sample(const cv::Mat &plane, int firstRow, int hist[256]);
+		// 16-bit gradient, |g| saturated to 8 bits, or 255 * |g| / gradMax
+		// when gradMax > 0
+		static void SampleAbs(const cv::Mat &grad, int firstRow, int gradMax,
+				int hist[256]);
 	};
 	ColorGradThreshBase(int pipelineInstanceNum, bool bParallel, bool bGpuAccel,
 			bool bVerbose);
@@ -141,20 +250,108 @@ public:
 	cv::Mat& getWarpImg() {
 		return warpImg;
 	}
+	const BitMask& getOutMask() const {
+		return outMask;
+	}
+	const std::vector<cv::Point>& getNonZero() const {
+		return nonzero;
+	}
+	// Hand the result to the next stage without a copy, dst's previous
+	// buffer comes back for the next frame
+	void MoveOutMask(BitMask &dst) {
+		outMask.swap(dst);
+	}
+	void MoveNonZero(std::vector<cv::Point> &dst) {
+		nonzero.swap(dst);
+	}
+	void setFused(bool bFused) {
+		this->bFused = bFused;
+	}
+	void setSparse(bool bSparse) {
+		this->bSparse = bSparse;
+	}
+	bool isSparse() const {
+		return bSparse;
+	}
+	void setColorLut(bool bColorLut) {
+		this->bColorLut = bColorLut;
+	}
+	void setBandsNum(int bandsNum) {
+		this->bandsNum = std::max(1, std::min(bandsNum, (int) MAX_THRESH_BANDS));
+	}
+	void setPriorBands(bool bPriorBands) {
+		this->bPriorBands = bPriorBands;
+	}
+	// Threshold the gradient scaled to the frame maximum, 255 * |g| / max,
+	// instead of saturated. Strips, bands and prior bands of the CPU
+	// backend scale to the maximum of the instance's previous frame and
+	// saturate on the first
+	void setGradNorm(bool bGradNorm) {
+		this->bGradNorm = bGradNorm;
+	}
+	// Fits of the tracked lanes in full resolution uniform coordinates,
+	// bPrior = false thresholds the whole frame
+	void setLanePrior(bool bPrior, const std::vector<float>& leftFit,
+			const std::vector<float>& rightFit) {
+		this->bPrior = bPriorBands && bPrior && leftFit.size() == 3
+				&& rightFit.size() == 3;
+		priorFit[0] = leftFit;
+		priorFit[1] = rightFit;
+	}
+	void setThreshController(
+			const std::shared_ptr<ThreshController>& threshController) {
+		this->threshController = threshController;
+	}
+	const Thresholds& getThresholds() const {
+		return thresh;
+	}
 protected:
 	cv::Mat outImg;
+	// Packed threshold mask, when the backend produces one
+	BitMask outMask;
 	cv::Mat warpImg;
-	struct Thresholds {
-		int red[2];
-		int sat[2];
-		int sobelx[2];
-	} thresh;
+	// Bird's-eye lane pixels in sparse mode, bottom-up for the row index
+	std::vector<cv::Point> nonzero;
+	bool bFused;
+	bool bSparse;
+	bool bColorLut;
+	bool bPriorBands;
+	bool bPrior;
+	bool bGradNorm;
+	std::vector<float> priorFit[2];
+	int bandsNum;
+	Thresholds thresh;
+	// Adaptive thresholds, stats are filled per band when a controller is
+	// set
+	std::shared_ptr<ThreshController> threshController;
+	std::vector<Histograms> stats;
 	virtual void SplitChannel(SPLIT_MODE mode) = 0;
 	virtual void CvtBGR2HLS() = 0;
 	virtual void ThresholdBinary(THRESH_MODE mode) = 0;
 	virtual void Sobelx() = 0;
 	virtual void AbsSobelx() = 0;
+	// x-gradient straight to its threshold mask
+	virtual void GradThresh() = 0;
 	virtual void CombBinaries() = 0;
+	// Warp and threshold in one pass, threshold in camera space and run
+	// the whole chain over one row band, CPU backend only
+	virtual void FusedThresh();
+	virtual void SparseThresh();
+	virtual void ThreshBand(cv::Range rows, int band);
+	// Row bands, queued together in sequential mode too like the warp's
+	bool isBanded() const {
+		return !bSparse && (bandsNum > 1 || bPriorBands);
+	}
+	// Band columns around the predicted lanes over rows and their Sobel
+	// halo, returns the number of ranges, overlapping ones are merged
+	int getPriorCols(cv::Range rows, cv::Range cols[2]) const;
+	// Bounds on the raw |g| of a 16-bit gradient equivalent to thresholding
+	// it saturated to 8 bits, or scaled to gradMax when gradMax > 0. No
+	// pixel passes when lowerb > upperb.
+	void getGradBounds(int gradMax, int &lowerb, int &upperb) const;
+private:
+	void BuildGraph();
+	void ReportDensity();
 };
 
 #endif /* INCLUDE_LANE_FOLLOWING_LANE_BASE_H_ */
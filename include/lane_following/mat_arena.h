@@ -0,0 +1,51 @@
+#ifndef INCLUDE_LANE_FOLLOWING_MAT_ARENA_H_
+#define INCLUDE_LANE_FOLLOWING_MAT_ARENA_H_
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/version.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+
+// Buffer pool of one pipeline instance. Mats attached to the arena return
+// their buffers to it on release and take them back on create, so the
+// per-frame release / create cycle of a stage stops reaching the heap once
+// every buffer size has been seen. Buffers are pooled by size class
+// (quarter powers of two), sizes that vary a little reuse the same blocks.
+// Thread-safe, bands of one instance allocate concurrently.
+class MatArena: public cv::MatAllocator {
+public:
+#if CV_VERSION_MAJOR >= 4
+	typedef cv::AccessFlag AccessFlag;
+#else
+	typedef int AccessFlag;
+#endif
+	MatArena();
+	virtual ~MatArena();
+	virtual cv::UMatData* allocate(int dims, const int* sizes, int type,
+			void* data, size_t* step, AccessFlag flags,
+			cv::UMatUsageFlags usageFlags) const override;
+	virtual bool allocate(cv::UMatData* u, AccessFlag accessFlags,
+			cv::UMatUsageFlags usageFlags) const override;
+	virtual void deallocate(cv::UMatData* u) const override;
+	// Buffers the mats own now go back to their own allocator, the next
+	// ones come from the arena
+	void Attach(std::initializer_list<cv::Mat*> mats) {
+		for (cv::Mat* m : mats) {
+			m->allocator = this;
+		}
+	}
+	// Requests no free block could serve, flat once warmed up
+	uint64_t getMisses() const;
+	uint64_t getReuses() const;
+private:
+	mutable std::mutex lock;
+	mutable std::multimap<size_t, cv::UMatData*> freeBlocks;
+	mutable uint64_t misses;
+	mutable uint64_t reuses;
+	static size_t SizeClass(size_t size);
+};
+
+#endif /* INCLUDE_LANE_FOLLOWING_MAT_ARENA_H_ */
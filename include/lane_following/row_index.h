@@ -0,0 +1,45 @@
+#ifndef INCLUDE_LANE_FOLLOWING_ROW_INDEX_H_
+#define INCLUDE_LANE_FOLLOWING_ROW_INDEX_H_
+
+#include <opencv2/core/types.hpp>
+#include <vector>
+
+class BitMask;
+
+// Set pixels of a mask bucketed by row, CSR style: x coordinates in one
+// array, ascending within a row, and the offset of every row's run. Rows
+// are stored bottom-up, the order the window search climbs them, so a
+// window reads its rows as one contiguous run of xs.
+class RowIndex {
+public:
+	RowIndex() :
+			rows(0) {
+	}
+	// One bottom-up pass over the mask, hist receives the column counts
+	// of rows histRow and below
+	void Build(const BitMask &mask, int histRow, std::vector<int> &hist);
+	// Same from bottom-up points, as sparse thresholding delivers them
+	void Build(const std::vector<cv::Point> &pts, cv::Size size, int histRow,
+			std::vector<int> &hist);
+	void clear();
+	int getRows() const {
+		return rows;
+	}
+	int size() const {
+		return (int) xs.size();
+	}
+	// x coordinates of row y
+	const short* begin(int y) const {
+		return xs.data() + rowStart[rows - 1 - y];
+	}
+	const short* end(int y) const {
+		return xs.data() + rowStart[rows - y];
+	}
+private:
+	int rows;
+	std::vector<short> xs;
+	// rows + 1 offsets, entry k starts the k-th row from the bottom
+	std::vector<int> rowStart;
+};
+
+#endif /* INCLUDE_LANE_FOLLOWING_ROW_INDEX_H_ */
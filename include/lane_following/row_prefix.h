@@ -0,0 +1,40 @@
+#ifndef INCLUDE_LANE_FOLLOWING_ROW_PREFIX_H_
+#define INCLUDE_LANE_FOLLOWING_ROW_PREFIX_H_
+
+#include <opencv2/core/types.hpp>
+#include <cstdint>
+#include <vector>
+
+class BitMask;
+class RowIndex;
+
+// Per-row prefix sums of a mask: count and x-coordinate sum of the set
+// pixels left of every column. Pixel count and coordinate sums of any
+// rectangle take two lookups per row, however dense the mask is.
+class RowPrefix {
+public:
+	RowPrefix() :
+			rows(0), cols(0) {
+	}
+	// One pass over the mask, hist receives the column counts of rows
+	// histRow and below
+	void Build(const BitMask &mask, int histRow, std::vector<int> &hist);
+	// Same from an index of the set pixels, cols wide
+	void Build(const RowIndex &index, int cols);
+	void clear();
+	bool empty() const {
+		return rows == 0;
+	}
+	// Set pixels in rowRange x colRange and the sums of their coordinates,
+	// ranges are clipped to the mask
+	void Window(cv::Range rowRange, cv::Range colRange, int &num, int &xSum,
+			int &ySum) const;
+private:
+	int rows;
+	int cols;
+	// rows x (cols + 1), entry x of a row covers columns 0 to x - 1
+	std::vector<uint16_t> count;
+	std::vector<int32_t> sumX;
+};
+
+#endif /* INCLUDE_LANE_FOLLOWING_ROW_PREFIX_H_ */
@@ -0,0 +1,92 @@
+#ifndef INCLUDE_LANE_FOLLOWING_SIMD_KERNELS_H_
+#define INCLUDE_LANE_FOLLOWING_SIMD_KERNELS_H_
+
+#include <opencv2/core/hal/interface.h>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/mat.inl.hpp>
+
+class BitMask;
+
+// Hand-vectorised kernels of the CPU backend, independent of how the linked
+// OpenCV was built. The widest variant the CPU supports (AVX-512, AVX2,
+// SSE4.2 or portable scalar) is picked once from cpuid, all variants give
+// the same results. Kernels work on 8-bit planes (16-bit for gradients) row
+// by row, so ROIs and row ranges can be passed directly; dst must be
+// allocated with the size of src.
+class SimdKernels {
+public:
+	enum ISA {
+		ISA_SCALAR, ISA_SSE42, ISA_AVX2, ISA_AVX512
+	};
+	static const SimdKernels& Get();
+	ISA getIsa() const {
+		return isa;
+	}
+	const char* getName() const;
+	// dst = channel of an interleaved 3 channel image
+	void ExtractChannel(const cv::Mat &src, int channel, cv::Mat &dst) const;
+	// Lightness and saturation planes of cvtColor(COLOR_BGR2HLS), computed
+	// straight from BGR without hue, and optionally the red plane
+	void LigSat(const cv::Mat &bgr, cv::Mat &lig, cv::Mat &sat) const;
+	void LigSatRed(const cv::Mat &bgr, cv::Mat &lig, cv::Mat &sat,
+			cv::Mat &red) const;
+	// dst = lowerb <= src <= upperb ? 255 : 0
+	void InRange(const cv::Mat &src, int lowerb, int upperb,
+			cv::Mat &dst) const;
+	// Same as InRange, packed into a bit mask
+	void InRangeBits(const cv::Mat &src, int lowerb, int upperb,
+			BitMask &dst) const;
+	// Row of an 8-bit mask to len bits, any non-zero byte is set
+	void PackMask(const uchar* src, uchar* dst, int len) const {
+		table.packMask(src, dst, len);
+	}
+	// dst = sat | (sobelx & red)
+	void CombMask(const cv::Mat &sat, const cv::Mat &sobelx,
+			const cv::Mat &red, cv::Mat &dst) const;
+	// Bits of lowerb <= |src| <= upperb for a 16-bit gradient, no
+	// saturation, the caller folds it into the bounds
+	void AbsInRangeBits(const cv::Mat &src, int lowerb, int upperb,
+			BitMask &dst) const;
+	// Sobel(src, CV_16S, 1, 0) with the default border and AbsInRangeBits in
+	// one pass, the gradient lives in registers only
+	void SobelxThreshBits(const cv::Mat &src, int lowerb, int upperb,
+			BitMask &dst) const;
+	// Bilinear 3 channel remap through WarpMaps fixed-point maps, constant
+	// zero border, within one level of cv::remap
+	void Remap(const cv::Mat &src, const cv::Mat &xy, const cv::Mat &a,
+			cv::Mat &dst) const;
+
+	// Row kernels of one variant
+	struct Table {
+		void (*extractChannel)(const uchar* src, int channel, uchar* dst,
+				int len);
+		// red may be null
+		void (*ligSatRed)(const uchar* bgr, uchar* lig, uchar* sat,
+				uchar* red, int len);
+		void (*inRange)(const uchar* src, uchar lowerb, uchar upperb,
+				uchar* dst, int len);
+		// Masks packed LSB first, dst holds (len + 7) / 8 bytes
+		void (*inRangeBits)(const uchar* src, uchar lowerb, uchar upperb,
+				uchar* dst, int len);
+		void (*packMask)(const uchar* src, uchar* dst, int len);
+		void (*combMask)(const uchar* sat, const uchar* sobelx,
+				const uchar* red, uchar* dst, int len);
+		void (*absInRangeBits)(const short* src, short lowerb, short upperb,
+				uchar* dst, int len);
+		// Rows above, at and below the output row
+		void (*sobelxThreshBits)(const uchar* r0, const uchar* r1,
+				const uchar* r2, short lowerb, short upperb, uchar* dst,
+				int len);
+		void (*remap)(const uchar* src, size_t step, int rows, int cols,
+				const short* xy, const ushort* a, uchar* dst, int len);
+	};
+	// Row kernels of a variant, null when the CPU lacks it. The tests hold
+	// every variant against the scalar one through this.
+	static const Table* getTable(ISA isa);
+private:
+	ISA isa;
+	Table table;
+	explicit SimdKernels(ISA isa);
+};
+
+#endif /* INCLUDE_LANE_FOLLOWING_SIMD_KERNELS_H_ */
@@ -0,0 +1,47 @@
+#ifndef INCLUDE_LANE_FOLLOWING_STEP_GRAPH_H_
+#define INCLUDE_LANE_FOLLOWING_STEP_GRAPH_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "completed_item.h"
+
+// Sub-steps of a stage and the steps whose outputs they read. Every step
+// is queued as soon as its inputs are done, independent steps overlap
+// without listing them as pairs. Sequential stages run one ready step at
+// a time, in the order the steps were added.
+class StepGraph {
+public:
+	StepGraph() :
+			done(0) {
+	}
+	static uint64_t Bit(int procStep) {
+		return (uint64_t) 1 << procStep;
+	}
+	bool empty() const {
+		return nodes.empty();
+	}
+	void clear() {
+		nodes.clear();
+		done = 0;
+	}
+	// procStep < 64, deps is a set of Bit(procStep)
+	void Add(int procStep, uint64_t deps = 0);
+	bool isDone() const;
+	// Queues the steps without inputs
+	void Start(CompletedItemList &items, bool bParallel, int &procStep);
+	// Retires the completed items and queues the steps they unblock, the
+	// list is empty once every step is done. Safe to repeat on a restored
+	// list, completed steps stay done.
+	void Next(CompletedItemList &items, bool bParallel, int &procStep);
+private:
+	struct Node {
+		int procStep;
+		uint64_t deps;
+	};
+	std::vector<Node> nodes;
+	uint64_t done;
+	void Issue(CompletedItemList &items, bool bParallel, int &procStep);
+};
+
+#endif /* INCLUDE_LANE_FOLLOWING_STEP_GRAPH_H_ */
@@ -11,6 +11,7 @@
 #include <opencv2/core/cvstd.hpp>
 #include <opencv2/core/mat.hpp>
 #include <opencv2/videoio.hpp>
+#include <cstdint>
 #include <cstdio>
 #include <list>
 #include <memory>
@@ -21,6 +22,8 @@
 
 struct tm_args {
 	cv::String videoFile;
+	cv::String calibFile;
+	cv::String mapCacheFile;
 	int threadPoolSize;
 	int pipelineInstNum;
 	int maxFrameCnt;
@@ -29,8 +32,22 @@ struct tm_args {
 	bool bParallel;
 	bool bGpuAccel;
 	bool bVerbose;
+	bool bRemap; // precomputed remap tables for the warp (CPU only)
+	bool bFused;
+	bool bSparse;
+	bool bPyramidRefine; // re-measure window centroids at full resolution
+	bool bColorLut; // classify colors through a lookup table (CPU only)
+	int pixelBudget; // adapt thresholds to this many mask pixels, 0 = fixed
+	bool bPriorBands; // threshold around the tracked lanes only (CPU only)
+	bool bGradNorm; // threshold the gradient scaled to its frame maximum
+	bool bPrefixSearch; // window statistics from per-row prefix sums
+	bool bDualSearch; // search both lanes in one task and one sweep
+	bool bPriorSearch; // search around the previous fits while tracked
+	WarpGeometry geometry;
 	tm_args() {
 		videoFile = "project_video.mp4";
+		calibFile = "calibration.yml";
+		mapCacheFile = "warp_maps.bin";
 		threadPoolSize = 8;
 		pipelineInstNum = 1;
 		maxFrameCnt = 100;
@@ -39,6 +56,17 @@ struct tm_args {
 		bParallel = false;
 		bGpuAccel = false;
 		bVerbose = false;
+		bRemap = false;
+		bFused = false;
+		bSparse = false;
+		bPyramidRefine = false;
+		bColorLut = false;
+		pixelBudget = 0;
+		bPriorBands = false;
+		bGradNorm = false;
+		bPrefixSearch = false;
+		bDualSearch = false;
+		bPriorSearch = false;
 	}
 };
 
@@ -46,7 +74,9 @@ template<typename WARP, typename COLOR_GRAD_THRESH, typename FIND_LANES>
 class ThreadManager: public ThreadBase {
 public:
 	enum {
-		MAX_PIPELINE_INST_NUM = 16
+		MAX_PIPELINE_INST_NUM = 16,
+		PRIOR_MIN_TRACKED = 3, // frames with both lanes before trusting them
+		ALLOC_WARMUP_FRAMES = 4 // frames until every buffer size was seen
 	};
 	ThreadManager(tm_args *args);
 	virtual ~ThreadManager();
@@ -66,6 +96,11 @@ public:
 	void PrintAvgFuncDurations();
 	long int getAvgDuration();
 	double getAvgSpeed();
+	// Mat buffers the frame and stage arenas could not serve from their free
+	// blocks, and how many after the warm-up frames (0 when steady). Other
+	// heap use, vectors and Mats outside the arenas, is not counted
+	uint64_t getArenaMisses();
+	uint64_t getSteadyArenaMisses();
 	ThreadWorker* getBusyThread(ThreadId threadId) {
 		for (auto it = busyList.begin(); it != busyList.end(); it++) {
 			if ((*it)->GetThreadId() == threadId) {
@@ -108,6 +143,9 @@ private:
 	tm_args args;
 
 	cv::VideoCapture videoCap;
+	// Captured frames, shared by the stages until their last reader
+	// releases them
+	MatArena frameArena;
 	cv::Mat frameImg;
 
 	std::list<ThreadWorker*> freeList; // list of free threads
@@ -135,6 +173,8 @@ private:
 	std::vector<double> speeds;
 	double lastAngle;
 	FindLanes::LaneHistory laneHistory;
+	int trackedCnt; // consecutive frames with both lanes found
+	uint64_t warmupMisses; // arena misses after the warm-up frames
 
 	cv::VideoWriter outVideoWr;
 #if DEBUG_ZONE_RAW_VIDEO
@@ -0,0 +1,35 @@
+#ifndef INCLUDE_LANE_FOLLOWING_THRESH_CONTROLLER_H_
+#define INCLUDE_LANE_FOLLOWING_THRESH_CONTROLLER_H_
+
+#include <mutex>
+
+#include "lane_base.h"
+
+// Keeps the lane mask within a pixel budget, window search time grows with
+// the mask pixels. Frames over budget raise the lower thresholds of each
+// sampled channel to where its histogram predicts the budget share of the
+// passing pixels, frames well under budget relax them back towards the
+// base thresholds. Channels without samples keep their thresholds. Shared
+// by all pipeline instances, frames report in any order.
+class ThreshController {
+public:
+	ThreshController(const ColorGradThreshBase::Thresholds &base,
+			int pixelBudget);
+	ColorGradThreshBase::Thresholds getThresholds() const;
+	void Update(const ColorGradThreshBase::Histograms &hist, int pixels);
+private:
+	enum {
+		GAIN_PCT = 50, // share of the predicted step taken per frame
+		RELAX_PCT = 50, // relax below this share of the budget
+		RELAX_DIV = 4 // relax by a quarter of the distance per frame
+	};
+	const ColorGradThreshBase::Thresholds base;
+	ColorGradThreshBase::Thresholds thresh;
+	int pixelBudget;
+	mutable std::mutex lock;
+	void Tighten(const int hist[256], int baseLo, int range[2],
+			double share);
+	void Relax(int baseLo, int range[2]);
+};
+
+#endif /* INCLUDE_LANE_FOLLOWING_THRESH_CONTROLLER_H_ */
@@ -6,11 +6,13 @@
 #include <opencv2/imgproc.hpp>
 
 #include "lane_base.h"
+#include "simd_kernels.h"
 
 class Warp: public WarpBase {
 public:
 	Warp(int pipelineInstanceNum, bool bParallel, bool bGpuAccel, bool bVerbose) :
 			WarpBase(pipelineInstanceNum, bParallel, bGpuAccel, bVerbose) {
+		arena.Attach( { &outImg });
 	}
 	virtual ~Warp() {
 		Deinit();
@@ -25,8 +27,37 @@ public:
 	cv::Mat& getOutImg() {
 		return outImg;
 	}
-	virtual void RunWarp() override {
-		warpPerspective(frameImg, outImg, perspTf, frameImg.size());
+	virtual void RunWarp(cv::Range rows) override {
+		// Fused and sparse thresholding sample the frame itself
+		if (bFused || bSparse) {
+			return;
+		}
+		cv::Rect band = geometry.getBand();
+		cv::Mat rowsImg = outImg.rowRange(rows);
+		// Lateral crop lies outside the source trapezoid
+		if (band.x > 0) {
+			rowsImg.colRange(0, band.x).setTo(cv::Scalar::all(0));
+			rowsImg.colRange(band.x + band.width, rowsImg.cols).setTo(
+					cv::Scalar::all(0));
+		}
+		cv::Mat bandImg = outImg(band).rowRange(rows);
+		if (warpMaps) {
+			SimdKernels::Get().Remap(frameImg, warpMaps->getXY().rowRange(rows),
+					warpMaps->getA().rowRange(rows), bandImg);
+		} else {
+			for (const RowSegment &segment : getRowSegments(rows)) {
+				cv::Mat segmentImg = outImg(band).rowRange(segment.rows);
+				warpPerspective(frameImg, segmentImg, segment.tf,
+						segmentImg.size());
+			}
+		}
+	}
+protected:
+	virtual void PrepWarp() override {
+		if (bFused || bSparse) {
+			return;
+		}
+		outImg.create(geometry.getSize(), frameImg.type());
 	}
 private:
 	cv::Mat outImg;
@@ -0,0 +1,111 @@
+#ifndef INCLUDE_LANE_FOLLOWING_WARP_GEOMETRY_H_
+#define INCLUDE_LANE_FOLLOWING_WARP_GEOMETRY_H_
+
+#include <opencv2/core/types.hpp>
+#include <algorithm>
+
+// Bird's-eye output layout. The source trapezoid maps onto the lane band
+// [margin, width - margin) x [0, height); columns outside the band are
+// lateral crop and are never sampled.
+// With pyramidScale > 1 the resolved layout is the reduced processing
+// resolution, full resolution coordinates are pyramidScale times larger.
+// An optional row profile samples the far end of the road (the top farRows
+// of the uniform layout) at farDensity output rows per road row. Uniform
+// coordinates keep a constant road length per row; fits, steering and
+// invPerspTf use them, the warped image and masks are in output rows.
+struct WarpGeometry {
+	int width; // output width, 0 = input width
+	int height; // output height, 0 = input height
+	int margin; // columns on each side of the lane band, -1 = default layout
+	int pyramidScale; // processing resolution divisor, 1 (full), 2 or 4
+	double farRows; // fraction of the uniform rows at the far end
+	double farDensity; // output rows per uniform row at the far end
+	// Resolved row profile
+	int uniformHeight;
+	int farUniformRows;
+	int farOutRows;
+	// Scale of the lane band relative to the default layout at input
+	// resolution, pixel-based hyperparameters are tuned for that layout
+	double scaleX;
+	double scaleY;
+	WarpGeometry() {
+		width = 0;
+		height = 0;
+		margin = -1;
+		pyramidScale = 1;
+		farRows = 0;
+		farDensity = 1;
+		uniformHeight = 0;
+		farUniformRows = 0;
+		farOutRows = 0;
+		scaleX = 1;
+		scaleY = 1;
+	}
+	WarpGeometry Resolve(cv::Size frameSize) const {
+		WarpGeometry g = *this;
+		if (g.width <= 0) {
+			g.width = frameSize.width;
+		}
+		if (g.height <= 0) {
+			g.height = frameSize.height;
+		}
+		if (g.margin < 0 || 2 * g.margin >= g.width) {
+			g.margin = g.width / 2 - g.width / 3;
+		}
+		if (g.pyramidScale > 1) {
+			g.width /= g.pyramidScale;
+			g.height /= g.pyramidScale;
+			g.margin /= g.pyramidScale;
+		} else {
+			g.pyramidScale = 1;
+		}
+		g.scaleX = (double) g.getBand().width / (2 * (frameSize.width / 3));
+		g.scaleY = (double) g.height / frameSize.height;
+		g.uniformHeight = g.height;
+		g.farUniformRows = 0;
+		g.farOutRows = 0;
+		if (g.farRows > 0 && g.farDensity > 0 && g.farDensity < 1) {
+			g.farUniformRows = cvRound(std::min(g.farRows, 1.0) * g.height);
+			g.farOutRows = std::max(cvRound(g.farUniformRows * g.farDensity),
+					1);
+			g.height += g.farOutRows - g.farUniformRows;
+		}
+		return g;
+	}
+	cv::Size getSize() const {
+		return cv::Size(width, height);
+	}
+	cv::Size getUniformSize() const {
+		return cv::Size(width, uniformHeight);
+	}
+	cv::Rect getBand() const {
+		return cv::Rect(margin, 0, width - 2 * margin, height);
+	}
+	// Output row <-> uniform row, piecewise linear
+	double RowToUniform(double row) const {
+		return row < farOutRows ?
+				row * farUniformRows / farOutRows :
+				row - farOutRows + farUniformRows;
+	}
+	double UniformToRow(double y) const {
+		return y < farUniformRows ?
+				y * farOutRows / farUniformRows :
+				y - farUniformRows + farOutRows;
+	}
+	// Resolved layout at full resolution
+	WarpGeometry getFull() const {
+		WarpGeometry g = *this;
+		g.width *= pyramidScale;
+		g.height *= pyramidScale;
+		g.margin *= pyramidScale;
+		g.uniformHeight *= pyramidScale;
+		g.farUniformRows *= pyramidScale;
+		g.farOutRows *= pyramidScale;
+		g.scaleX *= pyramidScale;
+		g.scaleY *= pyramidScale;
+		g.pyramidScale = 1;
+		return g;
+	}
+};
+
+#endif /* INCLUDE_LANE_FOLLOWING_WARP_GEOMETRY_H_ */
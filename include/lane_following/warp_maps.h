@@ -0,0 +1,112 @@
+#ifndef INCLUDE_LANE_FOLLOWING_WARP_MAPS_H_
+#define INCLUDE_LANE_FOLLOWING_WARP_MAPS_H_
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/mat.inl.hpp>
+#include <opencv2/core/types.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#include "warp_geometry.h"
+
+// Perspective matrices and fixed-point source coordinate maps of the
+// bird's-eye warp (the same layout convertMaps produces: CV_16SC2 integer
+// coordinates + CV_16UC1 index into the INTER_TAB_SIZE x INTER_TAB_SIZE
+// bilinear table). Built once per input resolution, calibration and output
+// layout, shared read-only by all warp instances and persisted to a cache
+// file per key that is memory-mapped on the next start.
+class WarpMaps {
+public:
+	struct Key {
+		int frameWidth;
+		int frameHeight;
+		uint64_t calibHash;
+		int width;
+		int height;
+		int margin;
+		int farUniformRows;
+		int farOutRows;
+		Key(cv::Size frameSize, uint64_t calibHash,
+				const WarpGeometry& geometry) :
+				frameWidth(frameSize.width), frameHeight(frameSize.height), calibHash(
+						calibHash), width(geometry.width), height(
+						geometry.height), margin(geometry.margin), farUniformRows(
+						geometry.farUniformRows), farOutRows(
+						geometry.farOutRows) {
+		}
+		uint64_t Hash() const;
+		bool operator<(const Key& d) const {
+			return std::tie(frameWidth, frameHeight, calibHash, width, height,
+					margin, farUniformRows, farOutRows)
+					< std::tie(d.frameWidth, d.frameHeight, d.calibHash,
+							d.width, d.height, d.margin, d.farUniformRows,
+							d.farOutRows);
+		}
+	};
+	WarpMaps(const cv::Point2f src[4], const cv::Point2f dst[4],
+			const WarpGeometry& geometry);
+	virtual ~WarpMaps();
+	static std::shared_ptr<const WarpMaps> Get(const Key& key,
+			const cv::Point2f src[4], const cv::Point2f dst[4],
+			const WarpGeometry& geometry, const std::string& cacheFile);
+	const cv::Mat& getPerspTf() const {
+		return perspTf;
+	}
+	const cv::Mat& getInvPerspTf() const {
+		return invPerspTf;
+	}
+	const cv::Mat& getXY() const {
+		return xy;
+	}
+	const cv::Mat& getA() const {
+		return a;
+	}
+	cv::Size getSize() const {
+		return size;
+	}
+private:
+	enum {
+		CACHE_MAGIC = 0x4d57464c, // "LFWM"
+		CACHE_VERSION = 2
+	};
+	struct CacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		int32_t frameWidth;
+		int32_t frameHeight;
+		int32_t width;
+		int32_t height;
+		int32_t margin;
+		int32_t farUniformRows;
+		int32_t farOutRows;
+		int32_t reserved;
+		uint64_t calibHash;
+		double perspTf[9];
+		double invPerspTf[9];
+	};
+	cv::Mat perspTf;
+	cv::Mat invPerspTf;
+	cv::Mat xy;
+	cv::Mat a;
+	cv::Size size;
+	void* mapAddr;
+	size_t mapLen;
+	WarpMaps();
+	void Build(const cv::Mat& invPerspTf, const WarpGeometry& geometry);
+	// Cache file of one key, derived from the configured name
+	static std::string getCacheFileName(const std::string& cacheFile,
+			const Key& key);
+	static std::shared_ptr<const WarpMaps> Map(const std::string& fileName,
+			const Key& key);
+	bool Save(const std::string& fileName, const Key& key) const;
+
+	static std::map<Key, std::shared_ptr<const WarpMaps>> cache;
+	static std::mutex cacheLock;
+};
+
+#endif /* INCLUDE_LANE_FOLLOWING_WARP_MAPS_H_ */
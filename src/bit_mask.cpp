@@ -0,0 +1,63 @@
+#include "lane_following/bit_mask.h"
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+
+#include "lane_following/simd_kernels.h"
+
+void BitMask::create(cv::Size size) {
+	if (size == this->size() && !words.empty()) {
+		std::fill(words.begin(), words.end(), 0);
+		return;
+	}
+	rows = size.height;
+	cols = size.width;
+	wordsPerRow = (cols + 63) / 64;
+	words.assign((size_t) rows * wordsPerRow, 0);
+}
+
+void BitMask::release() {
+	rows = cols = wordsPerRow = 0;
+	words.clear();
+}
+
+void BitMask::Pack(const cv::Mat &mask) {
+	create(mask.size());
+	PackRows(mask, cv::Range(0, rows));
+}
+
+void BitMask::PackRows(const cv::Mat &mask, cv::Range rowRange) {
+	CV_Assert(mask.type() == CV_8UC1 && mask.size() == size());
+	const SimdKernels &kernels = SimdKernels::Get();
+	for (int y = rowRange.start; y < rowRange.end; y++) {
+		kernels.PackMask(mask.ptr<uchar>(y), (uchar*) row(y), cols);
+	}
+}
+
+void BitMask::Unpack(cv::Mat &mask) const {
+	mask.create(size(), CV_8UC1);
+	for (int y = 0; y < rows; y++) {
+		const uint64_t* w = row(y);
+		uchar* p = mask.ptr<uchar>(y);
+		for (int x = 0; x < cols; x++) {
+			p[x] = ((w[x >> 6] >> (x & 63)) & 1) ? 255 : 0;
+		}
+	}
+}
+
+void BitMask::Comb(const BitMask &sat, const BitMask &sobelx,
+		const BitMask &red, BitMask &dst) {
+	CV_Assert(sobelx.size() == sat.size() && red.size() == sat.size());
+	dst.create(sat.size());
+	for (size_t i = 0; i < dst.words.size(); i++) {
+		dst.words[i] = sat.words[i] | (sobelx.words[i] & red.words[i]);
+	}
+}
+
+int BitMask::CountNonZero() const {
+	int count = 0;
+	for (uint64_t w : words) {
+		count += __builtin_popcountll(w);
+	}
+	return count;
+}
@@ -0,0 +1,61 @@
+#include "lane_following/calibration.h"
+
+#include <opencv2/core/persistence.hpp>
+
+#include "lane_following/debug.h"
+
+Calibration::Calibration() {
+	posXLower = 280;
+	posYLower = 670;
+	posXUpper = 504;
+	posYUpper = 470;
+	centerLower = 778;
+	centerUpper = 718;
+}
+
+bool Calibration::Load(const std::string& fileName) {
+	cv::FileStorage fs;
+	if (fileName.empty() || !fs.open(fileName, cv::FileStorage::READ)) {
+		return false;
+	}
+	// Missing keys keep their defaults
+	struct {
+		const char* name;
+		int* value;
+	} params[] = { { "pos_x_lower", &posXLower }, { "pos_y_lower", &posYLower },
+			{ "pos_x_upper", &posXUpper }, { "pos_y_upper", &posYUpper }, {
+					"center_lower", &centerLower }, { "center_upper",
+					&centerUpper } };
+	for (auto &param : params) {
+		cv::FileNode node = fs[param.name];
+		if (!node.empty()) {
+			*param.value = (int) node;
+		}
+	}
+	PRINT_DEBUG_MSG(DEBUG_ZONE_WARP,
+			"Calibration::Load, %s: lower %d,%d center %d, upper %d,%d center %d\n",
+			fileName.c_str(), posXLower, posYLower, centerLower, posXUpper,
+			posYUpper, centerUpper);
+	return true;
+}
+
+void Calibration::getSrc(cv::Point2f src[4]) const {
+	src[0] = cv::Point2f(posXUpper, posYUpper);
+	src[1] = cv::Point2f(2 * centerUpper - posXUpper, posYUpper);
+	src[2] = cv::Point2f(2 * centerLower - posXLower, posYLower);
+	src[3] = cv::Point2f(posXLower, posYLower);
+}
+
+uint64_t Calibration::Hash() const {
+	// FNV-1a
+	const int params[] = { posXLower, posYLower, posXUpper, posYUpper,
+			centerLower, centerUpper };
+	uint64_t hash = 14695981039346656037ULL;
+	for (int param : params) {
+		for (unsigned i = 0; i < sizeof(param); i++) {
+			hash ^= (uint8_t) (param >> (8 * i));
+			hash *= 1099511628211ULL;
+		}
+	}
+	return hash;
+}
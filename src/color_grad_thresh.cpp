@@ -3,14 +3,25 @@
 #include <opencv2/core/hal/interface.h>
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <vector>
 
 #include "lane_following/debug.h"
+#include "lane_following/simd_kernels.h"
 #include "lane_following/warp.h"
 
 ColorGradThresh::ColorGradThresh(int pipelineInstanceNum, bool bParallel,
 		bool bGpuAccel, bool bVerbose) :
-		ColorGradThreshBase(pipelineInstanceNum, bParallel, bGpuAccel, bVerbose) {
+		ColorGradThreshBase(pipelineInstanceNum, bParallel, bGpuAccel, bVerbose), gradMax(
+				0) {
+	arena.Attach( { &outImg, &binarySrc.threshRed,
+			&binarySrc.threshSat, &binarySrc.absSobelx, &binarySrc.threshSobelx,
+			&binaryDst.threshRed, &binaryDst.threshSat, &binaryDst.absSobelx,
+			&binaryDst.threshSobelx, &camera.lig, &camera.sat, &camera.red,
+			&camera.sobelx });
+	strip.Attach(arena);
 }
 
 ColorGradThresh::~ColorGradThresh() {
@@ -31,73 +42,103 @@ void ColorGradThresh::setParams(LaneBase* obj) {
 	Deinit();
 	Warp* warp = dynamic_cast<Warp*>(obj);
 	if (warp) {
-		warpImg = warp->getOutImg().clone();
+		// Warp writes a new buffer next frame, this one stays ours
+		warpImg = warp->getOutImg();
+		warpMaps = warp->getWarpMaps();
+		std::copy(warp->getSrc(), warp->getSrc() + 4, src);
+		// Picks up the controller's thresholds first
 		ColorGradThreshBase::setParams(obj);
+		colorLut = bColorLut ? ColorLut::Get(thresh.red, thresh.sat) : nullptr;
+		if (bGradNorm) {
+			// Strips only see their own rows, the frame maximum is known
+			// once they are all done and is used one frame later
+			int frameMax = strip.sobelMax;
+			strip.sobelMax = -1;
+			for (Strip &bandStrip : bandStrips) {
+				frameMax = std::max(frameMax, bandStrip.sobelMax);
+				bandStrip.sobelMax = -1;
+			}
+			if (frameMax >= 0) {
+				// A flat frame scales to all zeros
+				gradMax = std::max(frameMax, 1);
+			}
+		}
+		if (isBanded()) {
+			// Bands write their rows of the shared output in place. create
+			// keeps the arena allocator, assigning a new Mat would not
+			outImg.create(geometry.getSize(), CV_8UC1);
+			outImg.setTo(0);
+			outMask.create(geometry.getSize());
+			if ((int) bandStrips.size() != bandsNum) {
+				bandStrips.resize(bandsNum);
+				for (Strip &bandStrip : bandStrips) {
+					bandStrip.Attach(arena);
+				}
+			}
+		}
 	}
 }
 
 void ColorGradThresh::SplitChannel(SPLIT_MODE mode) {
 	switch (mode) {
 	case SPLIT_MODE_BGR: {
-		// Separate BRG color channels
-		std::vector<cv::Mat> bgrchannel;
-		split(warpImg, bgrchannel);
-		if (bgrchannel.size() != 3) {
-			PRINT_DEBUG_MSG(DEBUG_ZONE_COLOR_GRAD_THRESH,
-					"ColorGradTf::SplitChannel error bgrchannel.size()=%lu\n",
-					bgrchannel.size());
+		// Separate the red channel, the table classifies it with the rest
+		if (!colorLut) {
+			SimdKernels::Get().ExtractChannel(warpImg, 2, binarySrc.threshRed);
 		}
-		binarySrc.threshRed = bgrchannel[2];
 		break;
 	}
 	case SPLIT_MODE_HLS: {
-		// Separate HLS color channels
-		std::vector<cv::Mat> hlschannel;
-		split(hls, hlschannel);
-		if (hlschannel.size() != 3) {
-			PRINT_DEBUG_MSG(DEBUG_ZONE_COLOR_GRAD_THRESH,
-					"ColorGradTf::SplitChannel error hlschannel.size()=%lu\n",
-					hlschannel.size());
+		// Lightness and saturation in one pass over BGR, hue is never used
+		if (colorLut) {
+			colorLut->Apply(warpImg, binarySrc.absSobelx, binaryDst.threshSat,
+					binaryDst.threshRed);
+		} else {
+			SimdKernels::Get().LigSat(warpImg, binarySrc.absSobelx,
+					binarySrc.threshSat);
 		}
-		binarySrc.absSobelx = hlschannel[1];
-		binarySrc.threshSat = hlschannel[2];
-		hls.release();
 		break;
 	}
 	}
 }
 
 void ColorGradThresh::CvtBGR2HLS() {
-	// Convert to HLS color space
-	cvtColor(warpImg, hls, cv::COLOR_BGR2HLS);
+	// Nothing to convert, SplitChannel computes lightness and saturation
+	// straight from BGR
 }
 
 void ColorGradThresh::ThresholdBinary(THRESH_MODE mode) {
+	// Red and saturation masks come straight from the table
+	if (colorLut && mode != THRESH_MODE_ABS_SOBELX) {
+		if (mode == THRESH_MODE_RED) {
+			bits.red.Pack(binaryDst.threshRed);
+		} else {
+			bits.sat.Pack(binaryDst.threshSat);
+		}
+		return;
+	}
+	// Thresholds are packed straight into bit masks
+	const SimdKernels &kernels = SimdKernels::Get();
 	switch (mode) {
 	case THRESH_MODE_RED:
-		Threshold(binarySrc.threshRed, thresh.red[0], thresh.red[1],
-				binaryDst.threshRed);
+		kernels.InRangeBits(binarySrc.threshRed, thresh.red[0], thresh.red[1],
+				bits.red);
 		break;
 	case THRESH_MODE_SAT:
-		Threshold(binarySrc.threshSat, thresh.sat[0], thresh.sat[1],
-				binaryDst.threshSat);
+		kernels.InRangeBits(binarySrc.threshSat, thresh.sat[0], thresh.sat[1],
+				bits.sat);
 		break;
 	case THRESH_MODE_ABS_SOBELX:
-		Threshold(binarySrc.threshSobelx, thresh.sobelx[0], thresh.sobelx[1],
-				binaryDst.threshSobelx);
+		kernels.InRangeBits(binarySrc.threshSobelx, thresh.sobelx[0],
+				thresh.sobelx[1], bits.sobelx);
 		break;
 	}
 }
 
-void ColorGradThresh::Threshold(const cv::Mat &src, int lowerb, int upperb,
-		cv::Mat &dst) {
-	dst = cv::Mat::zeros(src.size(), src.type());
-	inRange(src, lowerb, upperb, dst);
-}
-
 void ColorGradThresh::Sobelx() {
-	// Take the derivative in x
-	Sobel(binarySrc.absSobelx, binaryDst.absSobelx, CV_64F, 1, 0);
+	// Take the derivative in x, 16 bits hold any 3x3 gradient of 8-bit
+	// input exactly
+	Sobel(binarySrc.absSobelx, binaryDst.absSobelx, CV_16S, 1, 0);
 }
 
 void ColorGradThresh::AbsSobelx() {
@@ -105,7 +146,354 @@ void ColorGradThresh::AbsSobelx() {
 	convertScaleAbs(binaryDst.absSobelx, binarySrc.threshSobelx);
 }
 
+void ColorGradThresh::GradThresh() {
+	// Lightness straight to the gradient mask, the 16-bit derivative never
+	// leaves registers unless its maximum or histogram is needed
+	const SimdKernels &kernels = SimdKernels::Get();
+	int lowerb, upperb;
+	if (!bGradNorm && !threshController) {
+		getGradBounds(0, lowerb, upperb);
+		kernels.SobelxThreshBits(binarySrc.absSobelx, lowerb, upperb,
+				bits.sobelx);
+		return;
+	}
+	Sobel(binarySrc.absSobelx, binaryDst.absSobelx, CV_16S, 1, 0);
+	int gradMax = 0;
+	if (bGradNorm) {
+		// A flat frame scales to all zeros
+		gradMax = std::max(
+				cvRound(cv::norm(binaryDst.absSobelx, cv::NORM_INF)), 1);
+	}
+	getGradBounds(gradMax, lowerb, upperb);
+	kernels.AbsInRangeBits(binaryDst.absSobelx, lowerb, upperb, bits.sobelx);
+	if (threshController) {
+		Histograms::SampleAbs(binaryDst.absSobelx, 0, gradMax,
+				stats[0].sobelx);
+	}
+}
+
 void ColorGradThresh::CombBinaries() {
-	// Combine three binary thresholds
-	outImg = binaryDst.threshSat | (binaryDst.threshSobelx & binaryDst.threshRed);
+	// Combine three binary thresholds, 64 pixels per operation
+	BitMask::Comb(bits.sat, bits.sobelx, bits.red, outMask);
+	if (threshController) {
+		if (!colorLut) {
+			Histograms::Sample(binarySrc.threshRed, 0, stats[0].red);
+			Histograms::Sample(binarySrc.threshSat, 0, stats[0].sat);
+		}
+#if DEBUG_ZONE_ALL_PROC_STEPS
+		// GradThresh samples the gradient itself otherwise
+		Histograms::Sample(binarySrc.threshSobelx, 0, stats[0].sobelx);
+#endif
+	}
+}
+
+void ColorGradThresh::FusedThresh() {
+	// Warp the frame in row strips and threshold each strip while it is
+	// cache-resident, the full warped image is never written
+	outImg.create(geometry.getSize(), CV_8UC1);
+	outImg.setTo(0);
+	outMask.create(geometry.getSize());
+	FusedRows(cv::Range(0, geometry.height), strip,
+			threshController ? &stats[0] : nullptr);
+}
+
+void ColorGradThresh::ThreshBand(cv::Range rows, int band) {
+	Strip &strip = bandStrips[band];
+	Histograms* hist = threshController ? &stats[band] : nullptr;
+	if (bPrior) {
+		PriorRows(rows, strip, hist);
+		return;
+	}
+	if (bFused) {
+		FusedRows(rows, strip, hist);
+		return;
+	}
+	// Warped rows plus a one row halo on each side
+	cv::Rect laneBand = geometry.getBand();
+	int h0 = std::max(rows.start - 1, 0);
+	int h1 = std::min(rows.end + 1, laneBand.height);
+	ThreshStrip(warpImg(laneBand).rowRange(h0, h1), rows.start - h0,
+			h1 - rows.end, thresh, strip, outImg(laneBand).rowRange(rows),
+			colorLut.get(), getSideBorder(), bGradNorm, gradMax);
+	outMask.PackRows(outImg, rows);
+	if (hist) {
+		SampleStrip(strip, rows.start - h0, rows.start, *hist);
+	}
+}
+
+void ColorGradThresh::PriorRows(cv::Range rows, Strip &strip,
+		Histograms* hist) {
+	// Only the columns around the tracked lanes, strip by strip
+	for (int y0 = rows.start; y0 < rows.end; y0 += FUSED_STRIP_ROWS) {
+		cv::Range stripRows(y0, std::min(y0 + FUSED_STRIP_ROWS, rows.end));
+		cv::Range cols[2];
+		int n = getPriorCols(stripRows, cols);
+		for (int i = 0; i < n; i++) {
+			ThreshRect(stripRows, cols[i], strip, hist);
+		}
+		outMask.PackRows(outImg, stripRows);
+	}
+}
+
+void ColorGradThresh::ThreshRect(cv::Range rows, cv::Range cols,
+		Strip &strip, Histograms* hist) {
+	// A one pixel halo on every side feeds the Sobel window and is not
+	// written, at the band edges ThreshStrip's borders match a full pass
+	cv::Rect band = geometry.getBand();
+	int h0 = std::max(rows.start - 1, 0);
+	int h1 = std::min(rows.end + 1, band.height);
+	int c0 = std::max(cols.start - 1, 0);
+	int c1 = std::min(cols.end + 1, band.width);
+	cv::Rect halo(c0, h0, c1 - c0, h1 - h0);
+	cv::Mat bgr;
+	if (bFused) {
+		if (!warpMaps) {
+			return;
+		}
+		strip.bgr.create(FUSED_STRIP_ROWS + 2, band.width, frameImg.type());
+		bgr = strip.bgr(cv::Rect(0, 0, halo.width, halo.height));
+		SimdKernels::Get().Remap(frameImg, warpMaps->getXY()(halo),
+				warpMaps->getA()(halo), bgr);
+	} else {
+		bgr = warpImg(band)(halo);
+	}
+	strip.mask.create(rows.size(), halo.width, CV_8UC1);
+	ThreshStrip(bgr, rows.start - h0, h1 - rows.end, thresh, strip,
+			strip.mask, colorLut.get(), getSideBorder(), bGradNorm, gradMax);
+	strip.mask.colRange(cols.start - c0, cols.end - c0).copyTo(
+			outImg(band)(cv::Rect(cols.start, rows.start, cols.size(),
+					rows.size())));
+	if (hist) {
+		SampleStrip(strip, rows.start - h0, rows.start, *hist);
+	}
+}
+
+void ColorGradThresh::SampleStrip(const Strip &strip, int haloTop,
+		int firstRow, Histograms &hist) const {
+	// Table lookups leave red and saturation as masks, only the gradient
+	// has values then
+	cv::Range rows(haloTop, haloTop + strip.absSobelx.rows);
+	if (!colorLut) {
+		Histograms::Sample(strip.red.rowRange(rows), firstRow, hist.red);
+		Histograms::Sample(strip.sat.rowRange(rows), firstRow, hist.sat);
+	}
+	Histograms::Sample(strip.absSobelx, firstRow, hist.sobelx);
+}
+
+void ColorGradThresh::FusedRows(cv::Range rows, Strip &strip,
+		Histograms* hist) {
+	cv::Rect band = geometry.getBand();
+	if (!warpMaps) {
+		PRINT_DEBUG_MSG(DEBUG_ZONE_ERROR,
+				"ColorGradThresh::FusedRows error: no warp maps\n");
+		return;
+	}
+	const cv::Mat &xy = warpMaps->getXY();
+	const cv::Mat &a = warpMaps->getA();
+	const SimdKernels &kernels = SimdKernels::Get();
+	strip.bgr.create(FUSED_STRIP_ROWS + 2, band.width, frameImg.type());
+	// Rows y0 - 1 and y0 were sampled as the previous strip's bottom
+	// halo, carry them over instead of sampling them again
+	int base = 0;
+	int sampled = 0;
+	for (int y0 = rows.start; y0 < rows.end; y0 += FUSED_STRIP_ROWS) {
+		int y1 = std::min(y0 + FUSED_STRIP_ROWS, rows.end);
+		int h0 = std::max(y0 - 1, 0);
+		int h1 = std::min(y1 + 1, band.height);
+		int carry = std::max(sampled - h0, 0);
+		if (carry > 0) {
+			strip.bgr.rowRange(h0 - base, sampled - base).copyTo(
+					strip.bgr.rowRange(0, carry));
+		}
+		cv::Mat bgr = strip.bgr.rowRange(0, h1 - h0);
+		cv::Mat fresh = bgr.rowRange(carry, h1 - h0);
+		kernels.Remap(frameImg, xy.rowRange(h0 + carry, h1),
+				a.rowRange(h0 + carry, h1), fresh);
+		base = h0;
+		sampled = h1;
+		ThreshStrip(bgr, y0 - h0, h1 - y1, thresh, strip,
+				outImg(band).rowRange(y0, y1), colorLut.get(), getSideBorder(),
+				bGradNorm, gradMax);
+		outMask.PackRows(outImg, cv::Range(y0, y1));
+		if (hist) {
+			SampleStrip(strip, y0 - h0, y0, *hist);
+		}
+	}
+}
+
+void ColorGradThresh::ThreshStrip(const cv::Mat &bgr, int haloTop,
+		int haloBottom, const Thresholds &thresh, Strip &strip, cv::Mat dst,
+		const ColorLut* colorLut, int sideBorder, bool bGradNorm,
+		int gradMax) {
+	// Halo rows feed the Sobel window only, at the image edges there is no
+	// halo and the default border matches a full-image Sobel. Past the side
+	// columns the Sobel reads sideBorder, zeros where a lateral crop
+	// borders the band, reflected at the image edges; halo columns are not
+	// kept. dst must be allocated, it is written in place.
+	const SimdKernels &kernels = SimdKernels::Get();
+	cv::Range rows(haloTop, bgr.rows - haloBottom);
+	cv::Range cols(1, bgr.cols + 1);
+	strip.lig.create(bgr.rows, bgr.cols + 2, CV_8UC1);
+	cv::Mat lig = strip.lig.colRange(cols);
+	if (colorLut) {
+		colorLut->Apply(bgr, lig, strip.sat, strip.red);
+		strip.threshRed = strip.red.rowRange(rows);
+		strip.threshSat = strip.sat.rowRange(rows);
+	} else {
+		kernels.LigSatRed(bgr, lig, strip.sat, strip.red);
+		kernels.InRange(strip.red.rowRange(rows), thresh.red[0], thresh.red[1],
+				strip.threshRed);
+		kernels.InRange(strip.sat.rowRange(rows), thresh.sat[0], thresh.sat[1],
+				strip.threshSat);
+	}
+	if (sideBorder == cv::BORDER_CONSTANT) {
+		strip.lig.col(0).setTo(0);
+		strip.lig.col(cols.end).setTo(0);
+	} else {
+		strip.lig.col(2).copyTo(strip.lig.col(0));
+		strip.lig.col(cols.end - 2).copyTo(strip.lig.col(cols.end));
+	}
+	Sobel(strip.lig, strip.sobelx, CV_16S, 1, 0);
+	cv::Mat sobelx = strip.sobelx(rows, cols);
+	if (bGradNorm) {
+		strip.sobelMax = std::max(strip.sobelMax,
+				cvRound(cv::norm(sobelx, cv::NORM_INF)));
+	}
+	if (bGradNorm && gradMax > 0) {
+		// Truncated like the staged chain, |g| past a lagging maximum
+		// saturates
+		if (strip.gradTabMax != gradMax) {
+			strip.gradTab.resize(SOBEL_MAX + 1);
+			for (int g = 0; g <= SOBEL_MAX; g++) {
+				strip.gradTab[g] = std::min(255 * g / gradMax, 255);
+			}
+			strip.gradTabMax = gradMax;
+		}
+		strip.absSobelx.create(sobelx.size(), CV_8UC1);
+		for (int y = 0; y < sobelx.rows; y++) {
+			const short* g = sobelx.ptr<short>(y);
+			uchar* p = strip.absSobelx.ptr<uchar>(y);
+			for (int x = 0; x < sobelx.cols; x++) {
+				p[x] = strip.gradTab[std::abs(g[x])];
+			}
+		}
+	} else {
+		convertScaleAbs(sobelx, strip.absSobelx);
+	}
+	kernels.InRange(strip.absSobelx, thresh.sobelx[0], thresh.sobelx[1],
+			strip.threshSobelx);
+	kernels.CombMask(strip.threshSat, strip.threshSobelx, strip.threshRed,
+			dst);
+}
+
+void ColorGradThresh::SparseThresh() {
+	// Threshold the camera frame inside the source trapezoid and warp only
+	// the surviving pixel coordinates, the frame is never resampled
+	cv::Rect band = geometry.getBand();
+	const double* M = invPerspTf.ptr<double>();
+	// Top and bottom of the trapezoid are horizontal, so every bird's-eye
+	// row samples a single camera row and is affine in x along it
+	double uc = band.x + band.width / 2.0;
+	auto rowY = [&](int v) {
+		double y = geometry.RowToUniform(v);
+		return (M[3] * uc + M[4] * y + M[5]) / (M[6] * uc + M[7] * y + M[8]);
+	};
+	auto edges = [&](double y, double &xl, double &xr) {
+		double t = (y - src[0].y) / (src[3].y - src[0].y);
+		xl = src[0].x + t * (src[3].x - src[0].x);
+		xr = src[1].x + t * (src[2].x - src[1].x);
+	};
+	int yTop = std::min(std::max(cvRound(rowY(0)), 0), frameImg.rows - 1);
+	int yBottom = std::min(std::max(cvRound(rowY(band.height - 1)), 0),
+			frameImg.rows - 1);
+	double xl0, xr0, xl1, xr1;
+	edges(yTop, xl0, xr0);
+	edges(yBottom, xl1, xr1);
+	// One pixel halo for the Sobel window
+	int x0 = std::max(cvFloor(std::min(xl0, xl1)) - 1, 0);
+	int x1 = std::min(cvCeil(std::max(xr0, xr1)) + 2, frameImg.cols);
+	int y0 = std::max(yTop - 1, 0);
+	int y1 = std::min(yBottom + 2, frameImg.rows);
+	// Lightness for the gradient, saturation and red as threshold masks
+	cv::Mat roi = frameImg(cv::Rect(x0, y0, x1 - x0, y1 - y0));
+	if (colorLut) {
+		colorLut->Apply(roi, camera.lig, camera.sat, camera.red);
+	} else {
+		const SimdKernels &kernels = SimdKernels::Get();
+		kernels.LigSatRed(roi, camera.lig, camera.sat, camera.red);
+		kernels.InRange(camera.sat, thresh.sat[0], thresh.sat[1], camera.sat);
+		kernels.InRange(camera.red, thresh.red[0], thresh.red[1], camera.red);
+	}
+	Sobel(camera.lig, camera.sobelx, CV_16S, 1, 0);
+
+	// The bird's-eye x-gradient is the camera one scaled by the camera
+	// pixels per bird's-eye pixel of its row
+	int frameMax = 0;
+	if (bGradNorm) {
+		// Largest bird's-eye gradient inside the trapezoid, a flat frame
+		// scales to all zeros
+		for (int y = yTop; y <= yBottom; y++) {
+			double xl, xr;
+			edges(y, xl, xr);
+			const short* sobelx = camera.sobelx.ptr<short>(y - y0);
+			int xBegin = std::max(cvFloor(xl), 0);
+			int xEnd = std::min(cvCeil(xr), frameImg.cols - 1);
+			int rowMax = 0;
+			for (int x = xBegin; x <= xEnd; x++) {
+				rowMax = std::max(rowMax, std::abs(sobelx[x - x0]));
+			}
+			frameMax = std::max(frameMax,
+					cvRound(rowMax * (xr - xl) / band.width));
+		}
+		frameMax = std::max(frameMax, 1);
+	}
+	int lowerb, upperb;
+	getGradBounds(frameMax, lowerb, upperb);
+
+	camera.rowStart.assign(1, 0);
+	camera.xs.clear();
+	for (int y = yTop; y <= yBottom; y++) {
+		double xl, xr;
+		edges(y, xl, xr);
+		double scale = (xr - xl) / band.width;
+		int sobelLo = cvCeil((lowerb - 0.5) / scale);
+		int sobelHi = upperb == SHRT_MAX ?
+				INT_MAX : cvCeil((upperb + 0.5) / scale) - 1;
+		const uchar* sat = camera.sat.ptr<uchar>(y - y0);
+		const uchar* red = camera.red.ptr<uchar>(y - y0);
+		const short* sobelx = camera.sobelx.ptr<short>(y - y0);
+		int xBegin = std::max(cvFloor(xl), 0);
+		int xEnd = std::min(cvCeil(xr), frameImg.cols - 1);
+		for (int x = xBegin; x <= xEnd; x++) {
+			int grad = std::abs(sobelx[x - x0]);
+			if (sat[x - x0]
+					|| (red[x - x0] && grad >= sobelLo && grad <= sobelHi)) {
+				camera.xs.push_back(x);
+			}
+		}
+		camera.rowStart.push_back(camera.xs.size());
+	}
+
+	// Spread every surviving camera pixel over the bird's-eye pixels that
+	// sample it, bottom-up so the row index buckets them in one pass
+	nonzero.clear();
+	for (int v = band.height - 1; v >= 0; v--) {
+		double yv = rowY(v);
+		int row = std::min(std::max(cvRound(yv), yTop), yBottom) - yTop;
+		double xl, xr;
+		edges(yv, xl, xr);
+		double scale = (xr - xl) / band.width;
+		for (int k = camera.rowStart[row + 1] - 1; k >= camera.rowStart[row];
+				k--) {
+			int x = camera.xs[k];
+			int u0 = std::max(cvCeil((x - 0.5 - xl) / scale), 0);
+			int u1 = std::min(cvCeil((x + 0.5 - xl) / scale), band.width);
+			for (int u = u1 - 1; u >= u0; u--) {
+				nonzero.push_back(cv::Point(band.x + u, v));
+			}
+		}
+	}
+	PRINT_DEBUG_MSG(DEBUG_ZONE_COLOR_GRAD_THRESH,
+			"ColorGradThresh::SparseThresh, %lu camera pixels, %lu points\n",
+			camera.xs.size(), nonzero.size());
 }
@@ -0,0 +1,79 @@
+#include "lane_following/color_lut.h"
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+
+#include "lane_following/debug.h"
+#include "lane_following/simd_kernels.h"
+
+std::map<ColorLut::Key, std::shared_ptr<const ColorLut>> ColorLut::cache;
+std::mutex ColorLut::cacheLock;
+
+ColorLut::ColorLut(const int red[2], const int sat[2]) :
+		ligSat(256 * 256) {
+	// Pixel (max, min, min) of every pair, row = max and col = min, through
+	// the same kernel as the direct path so both agree bit for bit
+	cv::Mat bgr(256, 256, CV_8UC3);
+	for (int vmax = 0; vmax < 256; vmax++) {
+		uchar* p = bgr.ptr<uchar>(vmax);
+		for (int vmin = 0; vmin < 256; vmin++) {
+			p[vmin * 3] = (uchar) vmax;
+			p[vmin * 3 + 1] = p[vmin * 3 + 2] = (uchar) std::min(vmin, vmax);
+		}
+	}
+	const SimdKernels &kernels = SimdKernels::Get();
+	cv::Mat lig, s, mask;
+	kernels.LigSat(bgr, lig, s);
+	kernels.InRange(s, sat[0], sat[1], mask);
+	for (int vmax = 0; vmax < 256; vmax++) {
+		for (int vmin = 0; vmin < 256; vmin++) {
+			ligSat[vmax * 256 + vmin] = lig.at<uchar>(vmax, vmin)
+					| (mask.at<uchar>(vmax, vmin) << 8);
+		}
+	}
+	for (int r = 0; r < 256; r++) {
+		redTab[r] = (r >= red[0] && r <= red[1]) ? 255 : 0;
+	}
+}
+
+std::shared_ptr<const ColorLut> ColorLut::Get(const int red[2],
+		const int sat[2]) {
+	Key key(red[0], red[1], sat[0], sat[1]);
+	std::lock_guard<std::mutex> lock(cacheLock);
+	auto it = cache.find(key);
+	if (it != cache.end()) {
+		return it->second;
+	}
+	if (cache.size() >= MAX_CACHED) {
+		cache.clear();
+	}
+	PRINT_DEBUG_MSG(DEBUG_ZONE_COLOR_GRAD_THRESH,
+			"ColorLut::Get, building red %d-%d sat %d-%d\n", red[0], red[1],
+			sat[0], sat[1]);
+	std::shared_ptr<const ColorLut> lut = std::make_shared<ColorLut>(red, sat);
+	cache[key] = lut;
+	return lut;
+}
+
+void ColorLut::Apply(const cv::Mat &bgr, cv::Mat &lig, cv::Mat &satMask,
+		cv::Mat &redMask) const {
+	CV_Assert(bgr.type() == CV_8UC3);
+	lig.create(bgr.size(), CV_8UC1);
+	satMask.create(bgr.size(), CV_8UC1);
+	redMask.create(bgr.size(), CV_8UC1);
+	const ushort* tab = ligSat.data();
+	for (int y = 0; y < bgr.rows; y++) {
+		const uchar* p = bgr.ptr<uchar>(y);
+		uchar* l = lig.ptr<uchar>(y);
+		uchar* s = satMask.ptr<uchar>(y);
+		uchar* r = redMask.ptr<uchar>(y);
+		for (int x = 0; x < bgr.cols; x++, p += 3) {
+			int vmax = std::max(std::max(p[0], p[1]), p[2]);
+			int vmin = std::min(std::min(p[0], p[1]), p[2]);
+			ushort e = tab[vmax * 256 + vmin];
+			l[x] = (uchar) e;
+			s[x] = (uchar) (e >> 8);
+			r[x] = redTab[p[2]];
+		}
+	}
+}
@@ -7,6 +7,7 @@
 #include <opencv2/cudafilters.hpp>
 #include <opencv2/cudaimgproc.hpp>
 #include <opencv2/imgproc.hpp>
+#include <algorithm>
 
 #include "lane_following/cuda_warp.h"
 
@@ -24,7 +25,7 @@ void CudaColorGradThresh::Init() {
 }
 
 void CudaColorGradThresh::Deinit() {
-	gpuImg.release();
+	// gpuImg is kept, copyTo reuses the device buffer every frame
 	binarySrc.clear();
 	binaryDst.clear();
 	ColorGradThreshBase::Deinit();
@@ -34,7 +35,7 @@ void CudaColorGradThresh::setParams(LaneBase* obj) {
 	Deinit();
 	CudaWarp* warp = dynamic_cast<CudaWarp*>(obj);
 	if (warp) {
-		gpuImg = warp->getOutImg().clone();
+		warp->getOutImg().copyTo(gpuImg);
 		gpuImg.download(warpImg);
 		ColorGradThreshBase::setParams(obj);
 	}
@@ -113,6 +114,22 @@ void CudaColorGradThresh::AbsSobelx() {
 	binaryDst.absSobelx.convertTo(binarySrc.threshSobelx, CV_8UC1);
 }
 
+void CudaColorGradThresh::GradThresh() {
+	// Threshold the 16-bit |g| directly, no 8-bit gradient is converted
+	Sobelx();
+	cv::cuda::abs(binaryDst.absSobelx, binaryDst.absSobelx);
+	int gradMax = 0;
+	if (bGradNorm) {
+		double maxVal;
+		cv::cuda::minMax(binaryDst.absSobelx, nullptr, &maxVal);
+		gradMax = std::max(cvRound(maxVal), 1);
+	}
+	int lowerb, upperb;
+	getGradBounds(gradMax, lowerb, upperb);
+	Threshold(binaryDst.absSobelx, lowerb, upperb, binaryDst.absSobelx);
+	binaryDst.absSobelx.convertTo(binaryDst.threshSobelx, CV_8UC1);
+}
+
 void CudaColorGradThresh::CombBinaries() {
 	// Combine three binary thresholds
 	cv::cuda::bitwise_and(binaryDst.threshRed, binaryDst.threshSobelx,
@@ -9,6 +9,7 @@
 #include <opencv2/imgproc.hpp>
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <iomanip>
 #include <iterator>
@@ -17,6 +18,7 @@
 #include <string>
 
 #include "lane_following/completed_item.h"
+#include "lane_following/step_graph.h"
 #include "lane_following/thread_base.h"
 
 FindLanes::FindLanes(int pipelineInstanceNum, bool bParallel, bool bGpuAccel,
@@ -24,10 +26,19 @@ FindLanes::FindLanes(int pipelineInstanceNum, bool bParallel, bool bGpuAccel,
 		LaneBase("FindLanes", pipelineInstanceNum, bParallel, bGpuAccel,
 				bVerbose) {
 	msgObjType = MSG_OBJ_TYPE_FIND_LANES;
+	arena.Attach( { &outImg, &leftLine.outImg, &leftLine.refineMask,
+			&rightLine.outImg, &rightLine.refineMask });
+	leftLine.strip.Attach(arena);
+	rightLine.strip.Attach(arena);
 	frameDuration = 1000000;
 	speed = 1000;
 	steeringAngle = 0.5;
 	bDetected = false;
+	bRefine = false;
+	bPrefix = false;
+	bDualSearch = false;
+	bPriorSearch = false;
+	bPrior = false;
 	maxSpeed = 0.75;
 }
 
@@ -40,18 +51,23 @@ void FindLanes::Init() {
 	// Number of sliding windows
 	hyperparams.windowsNum = 32;
 	// Width of the windows +/- margin
-	hyperparams.margin = 100;
+	hyperparams.margin = cvRound(100 * geometry.scaleX);
 	// Minimum number of pixels found to re-center window
-	hyperparams.minPix = 50;
-	// Height of windows - based on windowsNum above and image shape
-	hyperparams.windowHeight = img.rows / hyperparams.windowsNum;
+	hyperparams.minPix = cvRound(50 * geometry.scaleX * geometry.scaleY);
+	// Height of windows - based on windowsNum above and image shape, in
+	// uniform rows so every window covers the same road length
+	hyperparams.windowHeight = geometry.uniformHeight / hyperparams.windowsNum;
+	// Window centroids lie in full resolution uniform rows
+	leftLine.moments.setRange(0, imgSize.height - 1);
+	rightLine.moments.setRange(0, imgSize.height - 1);
 }
 
 void FindLanes::Deinit() {
-	img.release();
-	warpImg.release();
+	mask.release();
 	outImg.release();
 	nonzero.clear();
+	rowIndex.clear();
+	rowPrefix.clear();
 	histogram.clear();
 	hyperparams.clear();
 	leftLine.clear();
@@ -64,96 +80,83 @@ void FindLanes::setParams(LaneBase* obj) {
 	Deinit();
 	ColorGradThreshBase* colorGradTf = dynamic_cast<ColorGradThreshBase*>(obj);
 	if (colorGradTf) {
-		img = colorGradTf->getOutImg().clone();
-		warpImg = colorGradTf->getWarpImg().clone();
-		Init();
-		completedItemList.clear();
-		if (bParallel) {
-			completedItemList.addItem(PROC_STEP_FIND_NONZERO,
-					TASK_STATE_INITIALIZED);
-			completedItemList.addItem(PROC_STEP_HISTOGRAM,
-					TASK_STATE_INITIALIZED);
-			completedItemList.addItem(PROC_STEP_PREP_OUT_IMG,
-					TASK_STATE_INITIALIZED);
-			procStep = PROC_STEP_LEFT_LANE;
+		if (colorGradTf->isSparse()) {
+			// Lane pixels come as bird's-eye points, there is no mask
+			colorGradTf->MoveNonZero(nonzero);
+			searchSize = colorGradTf->getGeometry().getSize();
+		} else if (!colorGradTf->getOutMask().empty()) {
+			// Packed mask, an eighth of the 8-bit copy
+			colorGradTf->MoveOutMask(mask);
+			searchSize = mask.size();
 		} else {
-			completedItemList.addItem(PROC_STEP_FIND_NONZERO,
-					TASK_STATE_INITIALIZED);
-			procStep = PROC_STEP_FIND_NONZERO;
+			mask.Pack(colorGradTf->getOutImg());
+			searchSize = mask.size();
+		}
+		geometry = colorGradTf->getGeometry();
+		imgSize = geometry.getFull().getUniformSize();
+		thresh = colorGradTf->getThresholds();
+		Init();
+		if (graph.empty()) {
+			BuildGraph();
 		}
+		graph.Start(completedItemList, bParallel, procStep);
 		LaneBase::setParams(obj);
+		// Search runs at the reduced resolution, fits, steering and overlay
+		// at full resolution
+		if (geometry.pyramidScale > 1) {
+			cv::Mat scale = cv::Mat::eye(3, 3, CV_64F);
+			scale.at<double>(0, 0) = 1.0 / geometry.pyramidScale;
+			scale.at<double>(1, 1) = 1.0 / geometry.pyramidScale;
+			// New matrix, the shared one stays untouched
+			invPerspTf = cv::Mat(invPerspTf * scale);
+		}
 	}
 }
 
-void FindLanes::NextStep() {
-	completedItemList.rmCompleted();
-	if (completedItemList.empty()) {
-		if (bParallel) {
-			if (procStep == PROC_STEP_LEFT_LANE) {
-				completedItemList.addItem(PROC_STEP_LEFT_LANE,
-						TASK_STATE_INITIALIZED);
-				completedItemList.addItem(PROC_STEP_RIGHT_LANE,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_MAKE_OUT_IMG;
-			} else if (procStep == PROC_STEP_MAKE_OUT_IMG) {
-				completedItemList.addItem(PROC_STEP_MAKE_OUT_IMG,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_STEERING;
-			} else if (procStep == PROC_STEP_STEERING) {
-				completedItemList.addItem(PROC_STEP_STEERING,
-						TASK_STATE_INITIALIZED);
-				procStep = -1;
-			} else {
-				taskState = TASK_STATE_UNDEFINED;
-			}
-		} else {
-			if (procStep == PROC_STEP_FIND_NONZERO) {
-				completedItemList.addItem(PROC_STEP_HISTOGRAM,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_HISTOGRAM;
-			} else if (procStep == PROC_STEP_HISTOGRAM) {
-				completedItemList.addItem(PROC_STEP_PREP_OUT_IMG,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_PREP_OUT_IMG;
-			} else if (procStep == PROC_STEP_PREP_OUT_IMG) {
+void FindLanes::BuildGraph() {
+	typedef StepGraph S;
+	graph.Add(PROC_STEP_FIND_NONZERO);
+	graph.Add(PROC_STEP_PREP_OUT_IMG);
 #if DEBUG_ZONE_ALL_PROC_STEPS
-				completedItemList.addItem(PROC_STEP_WINDOW_SEARCH_LEFT,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_WINDOW_SEARCH_LEFT;
-			} else if (procStep == PROC_STEP_WINDOW_SEARCH_LEFT) {
-				completedItemList.addItem(PROC_STEP_CALC_POLY_LEFT,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_CALC_POLY_LEFT;
-			} else if (procStep == PROC_STEP_CALC_POLY_LEFT) {
-				completedItemList.addItem(PROC_STEP_WINDOW_SEARCH_RIGHT,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_WINDOW_SEARCH_RIGHT;
-			} else if (procStep == PROC_STEP_WINDOW_SEARCH_RIGHT) {
-				completedItemList.addItem(PROC_STEP_CALC_POLY_RIGHT,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_CALC_POLY_RIGHT;
-			} else if (procStep == PROC_STEP_CALC_POLY_RIGHT) {
+	graph.Add(PROC_STEP_HISTOGRAM, S::Bit(PROC_STEP_FIND_NONZERO));
+	uint64_t search = S::Bit(PROC_STEP_HISTOGRAM)
+			| S::Bit(PROC_STEP_PREP_OUT_IMG);
 #else
-				completedItemList.addItem(PROC_STEP_LEFT_LANE,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_LEFT_LANE;
-			} else if (procStep == PROC_STEP_LEFT_LANE) {
-				completedItemList.addItem(PROC_STEP_RIGHT_LANE,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_RIGHT_LANE;
-			} else if (procStep == PROC_STEP_RIGHT_LANE) {
+	uint64_t search = S::Bit(PROC_STEP_FIND_NONZERO)
+			| S::Bit(PROC_STEP_PREP_OUT_IMG);
 #endif
-				completedItemList.addItem(PROC_STEP_MAKE_OUT_IMG,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_MAKE_OUT_IMG;
-			} else if (procStep == PROC_STEP_MAKE_OUT_IMG) {
-				completedItemList.addItem(PROC_STEP_STEERING,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_STEERING;
-			} else {
-				taskState = TASK_STATE_UNDEFINED;
-			}
-		}
+	uint64_t lanes;
+	if (bDualSearch) {
+		// Both lanes in one sweep over the rows, one worker and one warm
+		// cache
+		graph.Add(PROC_STEP_BOTH_LANES, search);
+		lanes = S::Bit(PROC_STEP_BOTH_LANES);
+	} else {
+#if DEBUG_ZONE_ALL_PROC_STEPS
+		graph.Add(PROC_STEP_WINDOW_SEARCH_LEFT, search);
+		graph.Add(PROC_STEP_CALC_POLY_LEFT,
+				S::Bit(PROC_STEP_WINDOW_SEARCH_LEFT));
+		graph.Add(PROC_STEP_WINDOW_SEARCH_RIGHT, search);
+		graph.Add(PROC_STEP_CALC_POLY_RIGHT,
+				S::Bit(PROC_STEP_WINDOW_SEARCH_RIGHT));
+		lanes = S::Bit(PROC_STEP_CALC_POLY_LEFT)
+				| S::Bit(PROC_STEP_CALC_POLY_RIGHT);
+#else
+		graph.Add(PROC_STEP_LEFT_LANE, search);
+		graph.Add(PROC_STEP_RIGHT_LANE, search);
+		lanes = S::Bit(PROC_STEP_LEFT_LANE) | S::Bit(PROC_STEP_RIGHT_LANE);
+#endif
+	}
+	graph.Add(PROC_STEP_MAKE_OUT_IMG, lanes);
+	// Steering reads the previous frame's history, the manager holds it
+	// back until that frame is done
+	graph.Add(PROC_STEP_STEERING, lanes | S::Bit(PROC_STEP_MAKE_OUT_IMG));
+}
+
+void FindLanes::NextStep() {
+	graph.Next(completedItemList, bParallel, procStep);
+	if (completedItemList.empty()) {
+		taskState = TASK_STATE_UNDEFINED;
 	}
 }
 
@@ -165,17 +168,25 @@ void FindLanes::Process(std::shared_ptr<ThreadMsg> &msg, ThreadBase* thread) {
 
 	if (msg->procStep == PROC_STEP_FIND_NONZERO) {
 		FindNonZero();
-	} else if (msg->procStep == PROC_STEP_HISTOGRAM) {
-		Histogram();
+#if !DEBUG_ZONE_ALL_PROC_STEPS
+		// The column counts come with the index, only the peaks are left
+		if (!bPrior) {
+			Histogram();
+		}
+#endif
 	} else if (msg->procStep == PROC_STEP_PREP_OUT_IMG) {
 		PrepOutImg();
 #if DEBUG_ZONE_ALL_PROC_STEPS
+	} else if (msg->procStep == PROC_STEP_HISTOGRAM) {
+		Histogram();
 	} else if (msg->procStep == PROC_STEP_WINDOW_SEARCH_LEFT) {
 		if (leftLine.found) {
+#if DEBUG_ZONE_OUT_IMG
 			if (bVerbose) {
-				leftLine.outImg = cv::Mat::zeros(outImg.size(),
-						outImg.type());
+				leftLine.outImg.create(outImg.size(), outImg.type());
+				leftLine.outImg.setTo(0);
 			}
+#endif
 			WindowSearch(LANE_MODE_LEFT);
 		}
 	} else if (msg->procStep == PROC_STEP_CALC_POLY_LEFT) {
@@ -184,10 +195,12 @@ void FindLanes::Process(std::shared_ptr<ThreadMsg> &msg, ThreadBase* thread) {
 		}
 	} else if (msg->procStep == PROC_STEP_WINDOW_SEARCH_RIGHT) {
 		if (rightLine.found) {
+#if DEBUG_ZONE_OUT_IMG
 			if (bVerbose) {
-				rightLine.outImg = cv::Mat::zeros(outImg.size(),
-						outImg.type());
+				rightLine.outImg.create(outImg.size(), outImg.type());
+				rightLine.outImg.setTo(0);
 			}
+#endif
 			WindowSearch(LANE_MODE_RIGHT);
 		}
 	} else if (msg->procStep == PROC_STEP_CALC_POLY_RIGHT) {
@@ -197,23 +210,43 @@ void FindLanes::Process(std::shared_ptr<ThreadMsg> &msg, ThreadBase* thread) {
 #else
 	} else if (msg->procStep == PROC_STEP_LEFT_LANE) {
 		if (leftLine.found) {
+#if DEBUG_ZONE_OUT_IMG
 			if (bVerbose) {
-				leftLine.outImg = cv::Mat::zeros(outImg.size(), outImg.type());
+				leftLine.outImg.create(outImg.size(), outImg.type());
+				leftLine.outImg.setTo(0);
 			}
-			WindowSearch(LANE_MODE_LEFT);
+#endif
+			LaneCurrent* line = &leftLine;
+			SearchLanes(&line, 1);
 		}
-		if (leftLine.found)
-			CalcPoly(LANE_MODE_LEFT, false);
 	} else if (msg->procStep == PROC_STEP_RIGHT_LANE) {
 		if (rightLine.found) {
+#if DEBUG_ZONE_OUT_IMG
 			if (bVerbose) {
-				rightLine.outImg = cv::Mat::zeros(outImg.size(), outImg.type());
+				rightLine.outImg.create(outImg.size(), outImg.type());
+				rightLine.outImg.setTo(0);
 			}
-			WindowSearch(LANE_MODE_RIGHT);
+#endif
+			LaneCurrent* line = &rightLine;
+			SearchLanes(&line, 1);
 		}
-		if (rightLine.found)
-			CalcPoly(LANE_MODE_RIGHT, false);
 #endif
+	} else if (msg->procStep == PROC_STEP_BOTH_LANES) {
+		LaneCurrent* both[2] = { &leftLine, &rightLine };
+		LaneCurrent* lines[2];
+		int linesNum = 0;
+		for (LaneCurrent* line : both) {
+			if (line->found) {
+#if DEBUG_ZONE_OUT_IMG
+				if (bVerbose) {
+					line->outImg.create(outImg.size(), outImg.type());
+					line->outImg.setTo(0);
+				}
+#endif
+				lines[linesNum++] = line;
+			}
+		}
+		SearchLanes(lines, linesNum);
 	} else if (msg->procStep == PROC_STEP_MAKE_OUT_IMG) {
 		MakeOutImg();
 	} else if (msg->procStep == PROC_STEP_STEERING) {
@@ -230,15 +263,17 @@ const char* FindLanes::getProcStepString(int proc_step) {
 	switch (proc_step) {
 	case PROC_STEP_FIND_NONZERO:
 		return "FindNonZero";
-	case PROC_STEP_HISTOGRAM:
-		return "Histogram";
 	case PROC_STEP_PREP_OUT_IMG:
 		return "PrepOutImg";
 	case PROC_STEP_LEFT_LANE:
 		return "LeftLane";
 	case PROC_STEP_RIGHT_LANE:
 		return "RightLane";
+	case PROC_STEP_BOTH_LANES:
+		return "BothLanes";
 #if DEBUG_ZONE_ALL_PROC_STEPS
+	case PROC_STEP_HISTOGRAM:
+		return "Histogram";
 	case PROC_STEP_WINDOW_SEARCH_LEFT:
 		return "WindowSearchLeft";
 	case PROC_STEP_CALC_POLY_LEFT:
@@ -258,22 +293,65 @@ const char* FindLanes::getProcStepString(int proc_step) {
 }
 
 void FindLanes::FindNonZero() {
-	// Identify the x and y positions of all nonzero pixels in the image
-	findNonZero(img, nonzero);
-	reverse(nonzero.begin(), nonzero.end());
+	// Index the nonzero pixels by row bottom-up and take a histogram of
+	// the bottom half of the road in the same pass, sparse thresholding
+	// delivers the points already
+	int halfRow = geometry.UniformToRow(geometry.uniformHeight / 2);
+	if (bPrior) {
+		// Lanes are searched around the prior fits, columns are counted
+		// only for a lane that gets lost
+		halfRow = searchSize.height;
+		leftLine.found = true;
+		rightLine.found = true;
+	}
+	if (bPrefix && !mask.empty()) {
+		// Prefix sums straight from the mask, no index
+		rowPrefix.Build(mask, halfRow, histogram);
+	} else if (mask.empty()) {
+		rowIndex.Build(nonzero, searchSize, halfRow, histogram);
+		if (bPrefix) {
+			rowPrefix.Build(rowIndex, searchSize.width);
+		}
+	} else {
+		rowIndex.Build(mask, halfRow, histogram);
+	}
 }
 
 void FindLanes::PrepOutImg() {
 	// Create an output image to draw on and  visualize the result
 	if (bVerbose) {
 #if DEBUG_ZONE_OUT_IMG
+		cv::Mat maskImg;
+		if (!mask.empty()) {
+			mask.Unpack(maskImg);
+		} else {
+			maskImg = cv::Mat::zeros(searchSize, CV_8UC1);
+			for (const cv::Point &pt : nonzero) {
+				maskImg.at<uchar>(pt) = 255;
+			}
+		}
+		if (maskImg.size() != imgSize) {
+			// Back to uniform rows at full resolution
+			cv::Mat uniform(imgSize, CV_8UC1);
+			cv::Mat row;
+			int s = geometry.pyramidScale;
+			for (int y = 0; y < imgSize.height; y++) {
+				int r = std::min((int) geometry.UniformToRow(y / s),
+						maskImg.rows - 1);
+				resize(maskImg.row(r), row, cv::Size(imgSize.width, 1), 0, 0,
+						cv::INTER_NEAREST);
+				row.copyTo(uniform.row(y));
+			}
+			maskImg = uniform;
+		}
 		std::vector<cv::Mat> channels;
-		channels.push_back(img);
-		channels.push_back(img);
-		channels.push_back(img);
+		channels.push_back(maskImg);
+		channels.push_back(maskImg);
+		channels.push_back(maskImg);
 		merge(channels, outImg);
 #else
-		outImg = warpImg.clone();
+		// Overlay is projected and drawn straight onto the camera frame
+		frameImg.copyTo(outImg);
 #endif
 	}
 }
@@ -293,14 +371,7 @@ void FindLanes::MakeOutImg() {
 }
 
 void FindLanes::Histogram() {
-	// Take a histogram of the bottom half of the image
-	cv::Mat bottom_half = img(
-			cv::Rect(cv::Point(0, img.rows / 2),
-					cv::Point(img.cols, img.rows)));
-	cv::Mat hist;
-	reduce(bottom_half, hist, 0, CV_REDUCE_SUM, CV_32SC1);
-	hist.row(0).copyTo(histogram);
-
+	// FindNonZero counted the columns
 	// Find the peak of the left and right halves of the histogram
 	// These will be the starting cv::Point for the left and right lines
 	int midPoint = histogram.size() / 2;
@@ -316,130 +387,351 @@ void FindLanes::Histogram() {
 	}
 }
 
+void FindLanes::SearchLanes(LaneCurrent* lines[], int linesNum) {
+	LaneCurrent* lost[2];
+	int lostNum = 0;
+	if (bPrior) {
+		PriorSearch(lines, linesNum);
+		// Keep a line with enough bands whose fit moved little, search the
+		// others from scratch
+		int s = geometry.pyramidScale;
+		float maxShift = cvRound(PRIOR_MAX_SHIFT * geometry.scaleX) * s;
+		for (int k = 0; k < linesNum; k++) {
+			LaneCurrent &line = *lines[k];
+			LANE_MODE mode =
+					(&line == &leftLine) ? LANE_MODE_LEFT : LANE_MODE_RIGHT;
+			bool bKept = (int) line.pts.size() >= PRIOR_MIN_WINDOWS;
+			if (bKept) {
+				CalcPoly(mode, false);
+				const std::vector<float> &prior = priorFit[mode];
+				for (float u : { 0.0f, imgSize.height - 1.0f }) {
+					float dx = (line.fit[0] - prior[0]) * u * u
+							+ (line.fit[1] - prior[1]) * u
+							+ (line.fit[2] - prior[2]);
+					bKept = bKept && std::abs(dx) <= maxShift;
+				}
+			}
+			if (!bKept) {
+				PRINT_DEBUG_MSG(DEBUG_ZONE_FIND_LANES,
+						"FindLanes[%d]::SearchLanes, lost %s lane, frameIndex = %d\n",
+						pipelineInstanceNum,
+						mode == LANE_MODE_LEFT ? "left" : "right",
+						getFrameIndex());
+				line.ClearPts();
+				line.fit.clear();
+				line.fittedPts.clear();
+				FindBase(line);
+				if (line.found) {
+					lost[lostNum++] = &line;
+				}
+			}
+		}
+	} else {
+		std::copy(lines, lines + linesNum, lost);
+		lostNum = linesNum;
+	}
+	if (lostNum > 0) {
+		WindowSearch(lost, lostNum);
+		for (int k = 0; k < lostNum; k++) {
+			if (lost[k]->found) {
+				CalcPoly(
+						(lost[k] == &leftLine) ?
+								LANE_MODE_LEFT : LANE_MODE_RIGHT, false);
+			}
+		}
+	}
+}
+
+void FindLanes::PriorSearch(LaneCurrent* lines[], int linesNum) {
+	const std::vector<float>* fit[2];
+	for (int k = 0; k < linesNum; k++) {
+		fit[k] = &priorFit[(lines[k] == &leftLine) ? 0 : 1];
+		lines[k]->ClearPts();
+	}
+	int s = geometry.pyramidScale;
+	int margin = hyperparams.margin;
+	for (int window = 0; window < hyperparams.windowsNum; window++) {
+		// Same bands as the sliding windows, the column range follows the
+		// prior curve row by row
+		int uni_y_low = geometry.uniformHeight
+				- (window + 1) * hyperparams.windowHeight;
+		int uni_y_high = geometry.uniformHeight
+				- window * hyperparams.windowHeight;
+		int win_y_low = std::max(cvCeil(geometry.UniformToRow(uni_y_low)),
+				0);
+		int win_y_high = std::min(
+				cvCeil(geometry.UniformToRow(uni_y_high)),
+				searchSize.height);
+		int minPix = hyperparams.minPix * (win_y_high - win_y_low)
+				/ hyperparams.windowHeight;
+		int good_num[2] = { 0, 0 };
+		int sum_x[2] = { 0, 0 };
+		int sum_y[2] = { 0, 0 };
+		for (int y = win_y_low; y < win_y_high; y++) {
+			float u = geometry.RowToUniform(y) * s;
+			cv::Range cols[2];
+			int num[2];
+			int sumX[2];
+			int sumY[2];
+			for (int k = 0; k < linesNum; k++) {
+				const std::vector<float> &f = *fit[k];
+				int x = cvRound((f[0] * u * u + f[1] * u + f[2]) / s);
+				cols[k] = cv::Range(x - margin, x + margin);
+			}
+			WindowStats(cv::Range(y, y + 1), cols, linesNum, num, sumX, sumY);
+			for (int k = 0; k < linesNum; k++) {
+				good_num[k] += num[k];
+				sum_x[k] += sumX[k];
+				sum_y[k] += sumY[k];
+			}
+		}
+		for (int k = 0; k < linesNum; k++) {
+			if (good_num[k] <= minPix) {
+				continue;
+			}
+			// Centroid at full resolution in uniform rows, as in
+			// WindowSearch
+			cv::Point pt(sum_x[k] * s / good_num[k] + (s - 1) / 2,
+					(int) (geometry.RowToUniform(
+							(double) sum_y[k] / good_num[k]) * s)
+							+ (s - 1) / 2);
+			if (bRefine && s > 1) {
+				int x_avg = sum_x[k] / good_num[k];
+				cv::Rect rect((x_avg - margin) * s, uni_y_low * s,
+						2 * margin * s, (uni_y_high - uni_y_low) * s);
+				RefineCentroid(*lines[k], rect, pt);
+			}
+			lines[k]->AddPt(pt);
+		}
+	}
+}
+
+void FindLanes::FindBase(LaneCurrent& line) {
+	// Same peak as Histogram, over this line's half only
+	int halfRow = geometry.UniformToRow(geometry.uniformHeight / 2);
+	std::vector<int>& hist = line.baseHist;
+	ColumnHistogram(cv::Range(halfRow, searchSize.height), hist);
+	int midPoint = hist.size() / 2;
+	std::vector<int>::iterator first =
+			(&line == &leftLine) ? hist.begin() : hist.begin() + midPoint;
+	std::vector<int>::iterator last =
+			(&line == &leftLine) ? hist.begin() + midPoint : hist.end();
+	line.xBase = max_element(first, last) - hist.begin();
+	line.found = hist[line.xBase] > 0;
+}
+
 void FindLanes::WindowSearch(LANE_MODE mode) {
+	LaneCurrent* line = (mode == LANE_MODE_LEFT) ? &leftLine : &rightLine;
+	WindowSearch(&line, 1);
+}
+
+void FindLanes::WindowSearch(LaneCurrent* lines[], int linesNum) {
 	// Current positions to be updated for each window in windowsNum
-	unsigned y_current = 0;
-	int x_current = (mode == LANE_MODE_LEFT) ? leftLine.xBase : rightLine.xBase;
-	int count = 0;
-	// Create empty list to receive lane pixel indices
-	std::vector<cv::Point> lane_pts;
-	bool bFound = false;
-
-	// Step through the windows one by one
+	int x_current[2];
+	int count[2];
+	bool bActive[2];
+	cv::Rect rect[2];
+	cv::Range cols[2];
+	int good_num[2];
+	int sum_x[2];
+	int sum_y[2];
+	for (int k = 0; k < linesNum; k++) {
+		x_current[k] = lines[k]->xBase;
+		count[k] = 0;
+		bActive[k] = true;
+		// Empty list to receive lane pixel indices
+		lines[k]->ClearPts();
+	}
+	int s = geometry.pyramidScale;
+
+	// Step through the windows one by one, all lines advance together
 	for (int window = 0; window < hyperparams.windowsNum; window++) {
-		// Identify window boundaries in x and y
-		int win_y_low = img.rows - (window + 1) * hyperparams.windowHeight;
-		int win_y_high = img.rows - window * hyperparams.windowHeight;
-		int win_x_low = x_current - hyperparams.margin;
-		int win_x_high = x_current + hyperparams.margin;
-
-		// Draw the window on the visualization image
-		if (bVerbose) {
-			cv::Mat &img_src =
-					(mode == LANE_MODE_LEFT) ?
-							leftLine.outImg : rightLine.outImg;
-			cv::Rect rect = cv::Rect(cv::Point(win_x_low, win_y_low),
-					cv::Point(win_x_high, win_y_high));
-			rectangle(img_src, rect, cv::Scalar(255, 0, 0), 2);
-		}
-
-		// Identify the nonzero pixels in x and y within the window
-		std::vector<int> good_inds;
-		for (unsigned i = y_current; i < nonzero.size(); i++) {
-			if ((nonzero[i].y >= win_y_low) && (nonzero[i].y < win_y_high)) {
-				if ((nonzero[i].x >= win_x_low)
-						&& (nonzero[i].x < win_x_high)) {
-					good_inds.push_back(i);
-				}
+		// Identify window boundaries in x and y, y in uniform rows and in
+		// rows of the mask
+		int uni_y_low = geometry.uniformHeight
+				- (window + 1) * hyperparams.windowHeight;
+		int uni_y_high = geometry.uniformHeight
+				- window * hyperparams.windowHeight;
+		int win_y_low = cvCeil(geometry.UniformToRow(uni_y_low));
+		int win_y_high = cvCeil(geometry.UniformToRow(uni_y_high));
+		// Sparser rows hold fewer pixels per window
+		int minPix = hyperparams.minPix * (win_y_high - win_y_low)
+				/ hyperparams.windowHeight;
+		// Lines that gave up keep an empty column range
+		for (int k = 0; k < linesNum; k++) {
+			int win_x_low = x_current[k] - hyperparams.margin;
+			int win_x_high = x_current[k] + hyperparams.margin;
+			cols[k] = bActive[k] ?
+					cv::Range(win_x_low, win_x_high) : cv::Range(0, 0);
+			// Window at full resolution
+			rect[k] = cv::Rect(win_x_low * s, uni_y_low * s,
+					(win_x_high - win_x_low) * s,
+					(uni_y_high - uni_y_low) * s);
+			// Draw the window on the visualization image
+			if (bVerbose && bActive[k]) {
 #if DEBUG_ZONE_OUT_IMG
-				// Color in lane regions
-				if (bVerbose) {
-					cv::Mat &img_src =
-							(mode == LANE_MODE_LEFT) ?
-									leftLine.outImg : rightLine.outImg;
-					img_src.at<cv::Vec3b>(cv::Point(nonzero[i].x, nonzero[i].y)) =
-							cv::Vec3b(0, 255, 0);
+				rectangle(lines[k]->outImg, rect[k], cv::Scalar(255, 0, 0), 2);
+#else
+				lines[k]->windows.push_back(rect[k]);
+#endif
+			}
+		}
+
+		// Identify the nonzero pixels in x and y within the windows, one
+		// sweep over the band's rows for all lines
+		WindowStats(cv::Range(win_y_low, win_y_high), cols, linesNum,
+				good_num, sum_x, sum_y);
+
+		for (int k = 0; k < linesNum; k++) {
+			if (!bActive[k]) {
+				continue;
+			}
+			LaneCurrent &line = *lines[k];
+#if DEBUG_ZONE_OUT_IMG
+			// Color in lane regions, the prefix engine has no pixels to
+			// color
+			if (bVerbose) {
+				for (int y = std::max(win_y_low, 0);
+						y < std::min(win_y_high, rowIndex.getRows()); y++) {
+					for (const short* x = rowIndex.begin(y);
+							x < rowIndex.end(y); x++) {
+						line.outImg.at<cv::Vec3b>(
+								cv::Point(*x * s,
+										geometry.RowToUniform(y) * s)) =
+								cv::Vec3b(0, 255, 0);
+					}
 				}
+			}
 #endif
+			// If you found > minPix pixels, re-center next window
+			if (good_num[k] > minPix) {
+				int x_avg = sum_x[k] / good_num[k];
+				// Centroid at full resolution in uniform rows, optionally
+				// measured there
+				cv::Point pt(sum_x[k] * s / good_num[k] + (s - 1) / 2,
+						(int) (geometry.RowToUniform(
+								(double) sum_y[k] / good_num[k]) * s)
+								+ (s - 1) / 2);
+				if (bRefine && s > 1) {
+					RefineCentroid(line, rect[k], pt);
+				}
+				line.AddPt(pt);
+				x_current[k] = x_avg;
+				count[k] = 0;
 			} else {
-				y_current = i;
-				break;
+				count[k]++;
+				if (count[k] == hyperparams.windowsNum / 4) {
+					bActive[k] = false;
+				}
 			}
 		}
+		if (std::none_of(bActive, bActive + linesNum, [](bool b) {
+			return b;
+		})) {
+			break;
+		}
+	}
 
-		// If you found > minPix pixels, re-center next window
-		if (good_inds.size() > hyperparams.minPix) {
-			int sum_x = 0;
-			int sum_y = 0;
-			for (unsigned i = 0; i < good_inds.size(); i++) {
-				//lane_pts.push_back(cv::Point(nonzero[good_inds[i]].x, nonzero[good_inds[i]].y));
-				sum_x += nonzero[good_inds[i]].x;
-				sum_y += nonzero[good_inds[i]].y;
+	for (int k = 0; k < linesNum; k++) {
+		lines[k]->found = lines[k]->pts.size() > 3;
+	}
+}
+
+void FindLanes::WindowStats(cv::Range rows, const cv::Range cols[],
+		int linesNum, int num[], int sumX[], int sumY[]) const {
+	if (!rowPrefix.empty()) {
+		// Two lookups per row and line
+		for (int k = 0; k < linesNum; k++) {
+			rowPrefix.Window(rows, cols[k], num[k], sumX[k], sumY[k]);
+		}
+		return;
+	}
+	// Rows are read straight from the index, each once for all lines, x is
+	// ascending within a row
+	std::fill(num, num + linesNum, 0);
+	std::fill(sumX, sumX + linesNum, 0);
+	std::fill(sumY, sumY + linesNum, 0);
+	for (int y = std::max(rows.start, 0);
+			y < std::min(rows.end, rowIndex.getRows()); y++) {
+		for (int k = 0; k < linesNum; k++) {
+			if (cols[k].empty()) {
+				continue;
 			}
-			int x_avg = sum_x / good_inds.size();
-			int y_avg = sum_y / good_inds.size();
-			lane_pts.push_back(cv::Point(x_avg, y_avg));
-			x_current = x_avg;
-			count = 0;
-		} else {
-			count++;
-			if (count == hyperparams.windowsNum / 4) {
-				break;
+			const short* first = std::lower_bound(rowIndex.begin(y),
+					rowIndex.end(y), cols[k].start);
+			const short* last = std::lower_bound(first, rowIndex.end(y),
+					cols[k].end);
+			for (const short* x = first; x < last; x++) {
+				sumX[k] += *x;
 			}
+			num[k] += last - first;
+			sumY[k] += y * (int) (last - first);
 		}
 	}
+}
 
-	if (lane_pts.size() > 3) {
-		bFound = true;
+void FindLanes::ColumnHistogram(cv::Range rows,
+		std::vector<int>& hist) const {
+	hist.assign(searchSize.width, 0);
+	if (!rowPrefix.empty()) {
+		for (int x = 0; x < searchSize.width; x++) {
+			int num, sumX, sumY;
+			rowPrefix.Window(rows, cv::Range(x, x + 1), num, sumX, sumY);
+			hist[x] = num;
+		}
+		return;
 	}
+	for (int y = std::max(rows.start, 0);
+			y < std::min(rows.end, rowIndex.getRows()); y++) {
+		for (const short* x = rowIndex.begin(y); x < rowIndex.end(y); x++) {
+			hist[*x]++;
+		}
+	}
+}
 
-	switch (mode) {
-	case LANE_MODE_LEFT:
-		leftLine.found = bFound;
-		leftLine.pts = lane_pts;
-		break;
-	case LANE_MODE_RIGHT:
-		rightLine.found = bFound;
-		rightLine.pts = lane_pts;
-		break;
+void FindLanes::RefineCentroid(LaneCurrent& line, const cv::Rect& window,
+		cv::Point& pt) {
+	// Threshold the window again at full resolution, sampled straight from
+	// the camera frame
+	WarpGeometry full = geometry.getFull();
+	cv::Rect roi = window
+			& cv::Rect(full.margin, 0, full.getBand().width, full.uniformHeight);
+	if (roi.empty()) {
+		return;
+	}
+	// One pixel halo for the Sobel window, halo columns are not counted
+	cv::Rect halo(roi.x - 1, roi.y - 1, roi.width + 2, roi.height + 2);
+	cv::Mat shift = cv::Mat::eye(3, 3, CV_64F);
+	shift.at<double>(0, 2) = halo.x;
+	shift.at<double>(1, 2) = halo.y;
+	warpPerspective(frameImg, line.strip.bgr, invPerspTf * shift, halo.size(),
+			cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_CONSTANT);
+	line.refineMask.create(roi.height, halo.width, CV_8UC1);
+	ColorGradThresh::ThreshStrip(line.strip.bgr, 1, 1, thresh, line.strip,
+			line.refineMask);
+	cv::Moments m = moments(line.refineMask.colRange(1, halo.width - 1),
+			true);
+	int s = geometry.pyramidScale;
+	if (m.m00 > hyperparams.minPix * s * s) {
+		pt.x = cvRound(roi.x + m.m10 / m.m00);
+		pt.y = cvRound(roi.y + m.m01 / m.m00);
 	}
 }
 
 void FindLanes::CalcPoly(LANE_MODE mode, bool bPredicted) {
-	std::vector<cv::Point> &lane_pts =
-			(mode == LANE_MODE_LEFT) ? leftLine.pts : rightLine.pts;
+	LaneCurrent &line = (mode == LANE_MODE_LEFT) ? leftLine : rightLine;
 
-	// Extract left and right line pixel positions
-	std::vector<float> x_pts, y_pts, fit;
-	for (auto it : lane_pts) {
-		x_pts.push_back(it.x);
-		y_pts.push_back(it.y);
-	}
-
-	// Fit a second order polynomial
-	cv::Mat src_x = cv::Mat(x_pts.size(), 1, CV_32F, x_pts.data());
-	cv::Mat src_y = cv::Mat(y_pts.size(), 1, CV_32F, y_pts.data());
-	cv::Mat dst = cv::Mat(3, 1, CV_32F);
-	FitPoly(src_y, src_x, dst, 2);
-	dst.col(0).copyTo(fit);
+	// Fit a second order polynomial, the moments were gathered with the
+	// points
+	line.moments.Solve(line.fit);
 
 	// Calculate polynomial
-	std::vector<cv::Point> fittedpts;
-	for (float i = img.rows - 1; i >= 0; i--) {
-		fittedpts.push_back(
+	const std::vector<float> &fit = line.fit;
+	line.fittedPts.clear();
+	for (float i = imgSize.height - 1; i >= 0; i--) {
+		line.fittedPts.push_back(
 				cv::Point(fit[0] * pow(i, 2) + fit[1] * i + fit[2], i));
 	}
-
-	switch (mode) {
-	case LANE_MODE_LEFT:
-		leftLine.fit = fit;
-		leftLine.fittedPts = fittedpts;
-		break;
-	case LANE_MODE_RIGHT:
-		rightLine.fit = fit;
-		rightLine.fittedPts = fittedpts;
-		break;
-	}
 #if DEBUG_ZONE_OUT_IMG
 	//PlotPoly(mode, bPredicted);
 #endif
@@ -453,7 +745,11 @@ void FindLanes::PlotPoly(LANE_MODE mode, bool bPredicted) {
 		const cv::Point *pts = (const cv::Point*) fittedpts.data();
 		int npts = fittedpts.size();
 		if (bPredicted) {
+#if DEBUG_ZONE_OUT_IMG
 			polylines(outImg, &pts, &npts, 1, false, cv::Scalar(0, 0, 255), 2);
+#else
+			PlotProjected(fittedpts, false, cv::Scalar(0, 0, 255), 2);
+#endif
 		} else {
 			cv::Mat &img_src =
 					(mode == LANE_MODE_LEFT) ?
@@ -464,45 +760,28 @@ void FindLanes::PlotPoly(LANE_MODE mode, bool bPredicted) {
 	}
 }
 
-void FindLanes::FitPoly(const cv::Mat& src_x, const cv::Mat& src_y,
-		cv::Mat& dst, int order) {
-	CV_Assert(src_x.rows > 0);
-	CV_Assert(src_x.rows > 0);
-	CV_Assert(src_y.rows > 0);
-	CV_Assert(src_x.cols == 1);
-	CV_Assert(src_y.cols == 1);
-	CV_Assert(dst.cols == 1);
-	CV_Assert(dst.rows == (order + 1));
-	CV_Assert(order >= 1);
-
-	cv::Mat X;
-	X = cv::Mat::zeros(src_x.rows, order + 1, CV_32FC1);
-	cv::Mat copy;
-	// Vandermonde matrix
-	for (int i = 0, p = order; (i <= order) && (p >= 0); i++, p--) {
-		copy = src_x.clone();
-		pow(copy, p, copy);
-		cv::Mat M = X.col(i);
-		copy.col(0).copyTo(M);
-	}
-	// Scale X to improve condition number and solve
-	cv::Mat scale;
-	reduce(X.mul(X), scale, 0, CV_REDUCE_SUM);
-	sqrt(scale, scale);
-	for (int i = 0; i < X.rows; i++) {
-		cv::Mat M = X.row(i);
-		M /= scale;
-	}
-	// Linear least-squares
-	cv::Mat C;
-	solve(X.t() * X, X.t() * src_y, C, cv::DECOMP_LU);
-	C /= scale.t();
-	C.copyTo(dst);
+void FindLanes::ProjectPts(const std::vector<cv::Point>& src,
+		std::vector<cv::Point>& dst) {
+	// Bird's-eye to camera coordinates
+	std::vector<cv::Point2f> pts(src.begin(), src.end());
+	if (!pts.empty()) {
+		perspectiveTransform(pts, pts, invPerspTf);
+	}
+	dst.assign(pts.begin(), pts.end());
+}
+
+void FindLanes::PlotProjected(const std::vector<cv::Point>& pts, bool bClosed,
+		const cv::Scalar& color, int thickness) {
+	std::vector<cv::Point> projected;
+	ProjectPts(pts, projected);
+	polylines(outImg, projected, bClosed, color, thickness);
 }
 
 void FindLanes::Steering() {
-	float car_pos_x = img.cols / 2;
-	float car_pos_y = img.rows - 1;
+	// Fits are in full resolution coordinates
+	WarpGeometry full = geometry.getFull();
+	float car_pos_x = imgSize.width / 2;
+	float car_pos_y = imgSize.height - 1;
 
 	LANE_MODE laneMode = LANE_MODE_LEFT;
 	float displacement = 0;
@@ -511,17 +790,19 @@ void FindLanes::Steering() {
 
 	if (leftLine.found && rightLine.found
 			&& (rightLine.fittedPts[0].x - leftLine.fittedPts[0].x
-					> hyperparams.margin * 2)) {
+					> hyperparams.margin * 2 * geometry.pyramidScale)) {
 		// Calculate line angles
 		rightLine.angle =
 				atan2(
 						(rightLine.fittedPts[0].x
-								- rightLine.fittedPts[img.rows / 3].x),
+								- rightLine.fittedPts[imgSize.height / 3].x),
 						(rightLine.fittedPts[0].y
-								- rightLine.fittedPts[img.rows / 3].y));
+								- rightLine.fittedPts[imgSize.height / 3].y));
 		leftLine.angle = atan2(
-				(leftLine.fittedPts[0].x - leftLine.fittedPts[img.rows / 3].x),
-				(leftLine.fittedPts[0].y - leftLine.fittedPts[img.rows / 3].y));
+				(leftLine.fittedPts[0].x
+						- leftLine.fittedPts[imgSize.height / 3].x),
+				(leftLine.fittedPts[0].y
+						- leftLine.fittedPts[imgSize.height / 3].y));
 		// Check if lines are parallel
 		bool bParallel = false;
 		if (std::abs(rightLine.angle - leftLine.angle) > 15 * 3.14 / 180) {
@@ -657,9 +938,11 @@ void FindLanes::Steering() {
 	// Find target point
 	float speed_m_p_s = speed * 0.00025;
 	float speed_m_p_us = speed_m_p_s / 1000000;
-	float speed_pix_p_us = speed_m_p_us * img.rows;
+	float speed_pix_p_us = speed_m_p_us * imgSize.height;
+	// Curvature in the default bird's-eye layout
 	float div =
-			(laneMode == LANE_MODE_LEFT ? leftLine.fit[0] : rightLine.fit[0]);
+			(laneMode == LANE_MODE_LEFT ? leftLine.fit[0] : rightLine.fit[0])
+					* full.scaleY * full.scaleY / full.scaleX;
 	float N = FLT_MAX;
 	if (div != 0) {
 		N = std::abs(0.0005 / div);
@@ -719,26 +1002,49 @@ void FindLanes::Steering() {
 		cv::Point p2(car_pos_x, dst_y);
 		cv::Point p3(dst_x, dst_y);
 
-		cv::line(outImg, p1, p2, cv::Scalar::all(255), 2);
-		cv::line(outImg, p2, p3, cv::Scalar::all(255), 2);
-		cv::arrowedLine(outImg, p1, p3, cv::Scalar::all(255), 2);
-
 		// Frame duration indicator
 		float pix_p_N_frames = speed_pix_p_us * frameDuration * N;
-		cv::Point p4 = p1;
+		std::vector<cv::Point> durationPts(1, p1);
 		for (int i = 1; i <= 3; i++) {
 			float y = pix_p_N_frames * i / 3;
-			cv::Point p5(car_pos_x, car_pos_y - y);
-			cv::Scalar color = (
-					i == 1 ? cv::Scalar(0, 0, 255) :
-					i == 2 ? cv::Scalar(0, 255, 255) : cv::Scalar(0, 255, 0));
-			cv::line(outImg, p4, p5, color, 2);
-			p4 = p5;
+			durationPts.push_back(cv::Point(car_pos_x, car_pos_y - y));
 		}
+		const cv::Scalar durationColors[] = { cv::Scalar(0, 0, 255),
+				cv::Scalar(0, 255, 255), cv::Scalar(0, 255, 0) };
 
-#if 1
-		warpPerspective(outImg, outImg, invPerspTf, outImg.size());
+#if DEBUG_ZONE_OUT_IMG
+		cv::line(outImg, p1, p2, cv::Scalar::all(255), 2);
+		cv::line(outImg, p2, p3, cv::Scalar::all(255), 2);
+		cv::arrowedLine(outImg, p1, p3, cv::Scalar::all(255), 2);
+		for (int i = 1; i <= 3; i++) {
+			cv::line(outImg, durationPts[i - 1], durationPts[i],
+					durationColors[i - 1], 2);
+		}
+
+		warpPerspective(outImg, outImg, invPerspTf, frameImg.size());
 		addWeighted(outImg, 0.6, frameImg, 0.4, 0, outImg);
+#else
+		// Sliding windows
+		for (LaneCurrent* line : { &leftLine, &rightLine }) {
+			for (const cv::Rect &rect : line->windows) {
+				std::vector<cv::Point> corners = { rect.tl(), cv::Point(
+						rect.x + rect.width, rect.y), rect.br(), cv::Point(
+						rect.x, rect.y + rect.height) };
+				PlotProjected(corners, true, cv::Scalar(255, 0, 0), 2);
+			}
+		}
+
+		std::vector<cv::Point> arrowPts = { p1, p2, p3 };
+		ProjectPts(arrowPts, arrowPts);
+		cv::line(outImg, arrowPts[0], arrowPts[1], cv::Scalar::all(255), 2);
+		cv::line(outImg, arrowPts[1], arrowPts[2], cv::Scalar::all(255), 2);
+		cv::arrowedLine(outImg, arrowPts[0], arrowPts[2], cv::Scalar::all(255),
+				2);
+		ProjectPts(durationPts, durationPts);
+		for (int i = 1; i <= 3; i++) {
+			cv::line(outImg, durationPts[i - 1], durationPts[i],
+					durationColors[i - 1], 2);
+		}
 #endif
 
 		int count = 1;
@@ -762,7 +1068,7 @@ void FindLanes::Steering() {
 			case 3:
 				name = "Offset";
 				unit = "m";
-				value = (offset / img.cols) * 1.4;
+				value = (offset / full.scaleX / frameImg.cols) * 1.4;
 				break;
 			case 4:
 				name = "Moment FPS";
@@ -792,7 +1098,7 @@ void FindLanes::Steering() {
 #if 1
 	double max_pix_p_frame = sum / 3; // 3 frames is min
 	double fps = 1000000 / frameDuration;
-	maxSpeed = fps * max_pix_p_frame / 720;
+	maxSpeed = fps * max_pix_p_frame / 720 / full.scaleY;
 #endif
 }
 
@@ -1,9 +1,15 @@
 #include "lane_following/lane_base.h"
 
+#include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
 #include <list>
 #include <vector>
 
+#include "lane_following/thresh_controller.h"
+
 LaneBase::LaneBase(std::string moduleName, int pipelineInstanceNum,
 		bool bParallel, bool bGpuAccel, bool bVerbose) :
 		moduleName(moduleName), pipelineInstanceNum(pipelineInstanceNum), bParallel(
@@ -28,8 +34,9 @@ void LaneBase::Run(std::shared_ptr<ThreadMsg> &msg, ThreadBase* thread) {
 
 void LaneBase::setParams(LaneBase* obj) {
 	if (obj) {
-		frameImg = obj->getFrameImg().clone();
-		invPerspTf = obj->getInvPerspTf().clone();
+		frameImg = obj->getFrameImg();
+		invPerspTf = obj->getInvPerspTf();
+		geometry = obj->getGeometry();
 		frameIndex = obj->getFrameIndex();
 		startTime = obj->getStartTime();
 	}
@@ -38,7 +45,8 @@ void LaneBase::setParams(LaneBase* obj) {
 
 WarpBase::WarpBase(int pipelineInstanceNum, bool bParallel, bool bGpuAccel,
 		bool bVerbose) :
-		LaneBase("Warp", pipelineInstanceNum, bParallel, bGpuAccel, bVerbose) {
+		LaneBase("Warp", pipelineInstanceNum, bParallel, bGpuAccel, bVerbose), bRemap(
+				false), bFused(false), bSparse(false), bandsNum(1) {
 	msgObjType = MSG_OBJ_TYPE_WARP;
 }
 
@@ -47,28 +55,69 @@ WarpBase::~WarpBase() {
 }
 
 void WarpBase::Init() {
-	int pos_x_lower = 280;
-	int pos_y_lower = 670;
-	int pos_x_upper = 504;
-	int pos_y_upper = 470;
-	int center_lower = 778;
-	int center_upper = 718;
-
-	src[0] = cv::Point(pos_x_upper, pos_y_upper);
-	src[1] = cv::Point(2 * center_upper - pos_x_upper, pos_y_upper);
-	src[2] = cv::Point(2 * center_lower - pos_x_lower, pos_y_lower);
-	src[3] = cv::Point(pos_x_lower, pos_y_lower);
-
-	int persp_center = frameImg.cols / 2;
-	int persp_height = frameImg.rows;
-	int persp_margin = frameImg.cols / 3;
-	dst[0] = cv::Point2f(persp_center - persp_margin, 0); // Top left
-	dst[1] = cv::Point2f(persp_center + persp_margin, 0); // Top right
-	dst[2] = cv::Point2f(persp_center + persp_margin, persp_height); // Bottom right
-	dst[3] = cv::Point2f(persp_center - persp_margin, persp_height); // Bottom left
-
-	perspTf = getPerspectiveTransform(src, dst);
-	invPerspTf = getPerspectiveTransform(dst, src);
+	// Camera geometry is fixed, recalculate only on resolution change
+	if (!perspTf.empty() && tfSize == frameImg.size()) {
+		return;
+	}
+	tfSize = frameImg.size();
+
+	calibration.getSrc(src);
+
+	geometry = requestedGeometry.Resolve(frameImg.size());
+	cv::Rect band = geometry.getBand();
+	dst[0] = cv::Point2f(band.x, 0); // Top left
+	dst[1] = cv::Point2f(band.x + band.width, 0); // Top right
+	// Uniform rows, the row profile is applied on top
+	dst[2] = cv::Point2f(band.x + band.width, geometry.uniformHeight); // Bottom right
+	dst[3] = cv::Point2f(band.x, geometry.uniformHeight); // Bottom left
+
+	// Matrices and fixed-point remap tables come from the map cache, shared
+	// by all pipeline instances and persisted across runs
+	warpMaps.reset();
+	if (bRemap) {
+		WarpMaps::Key key(tfSize, calibration.Hash(), geometry);
+		warpMaps = WarpMaps::Get(key, src, dst, geometry, mapCacheFile);
+		warpMaps->getPerspTf().copyTo(perspTf);
+		// Stages of earlier frames may still hold the old matrix
+		invPerspTf = warpMaps->getInvPerspTf().clone();
+	} else {
+		perspTf = getPerspectiveTransform(src, dst);
+		invPerspTf = getPerspectiveTransform(dst, src);
+	}
+
+	// Transform into the lane band only, lateral crop is never sampled
+	cv::Mat shift = cv::Mat::eye(3, 3, CV_64F);
+	shift.at<double>(0, 2) = -band.x;
+	bandPerspTf = shift * perspTf;
+}
+
+std::vector<WarpBase::RowSegment> WarpBase::getRowSegments(
+		cv::Range rows) const {
+	// Pieces of constant row density, each with the band transform that
+	// puts its first row on row 0
+	std::vector<RowSegment> segments;
+	int split = std::min(std::max(geometry.farOutRows, rows.start), rows.end);
+	cv::Range ranges[] = { cv::Range(rows.start, split), cv::Range(split,
+			rows.end) };
+	for (int i = 0; i < 2; i++) {
+		if (ranges[i].start >= ranges[i].end) {
+			continue;
+		}
+		cv::Mat rowTf = cv::Mat::eye(3, 3, CV_64F);
+		if (i == 0) {
+			rowTf.at<double>(1, 1) = (double) geometry.farOutRows
+					/ geometry.farUniformRows;
+		} else {
+			rowTf.at<double>(1, 2) = geometry.farOutRows
+					- geometry.farUniformRows;
+		}
+		rowTf.at<double>(1, 2) -= ranges[i].start;
+		RowSegment segment;
+		segment.rows = ranges[i];
+		segment.tf = rowTf * bandPerspTf;
+		segments.push_back(segment);
+	}
+	return segments;
 }
 
 void WarpBase::Deinit() {
@@ -78,14 +127,23 @@ void WarpBase::Deinit() {
 void WarpBase::setParams(LaneBase* obj) {
 	Deinit();
 	Init();
-	procStep = PROC_STEP_WARP;
-	completedItemList.clear();
-	completedItemList.addItem(procStep, TASK_STATE_INITIALIZED);
+	if (graph.empty()) {
+		if (bandsNum > 1) {
+			// Bands write disjoint rows of the preallocated output
+			for (int i = 0; i < bandsNum; i++) {
+				graph.Add(PROC_STEP_WARP_BAND + i);
+			}
+		} else {
+			graph.Add(PROC_STEP_WARP);
+		}
+	}
+	graph.Start(completedItemList, true, procStep);
+	PrepWarp();
 	LaneBase::setParams(this);
 }
 
 void WarpBase::NextStep() {
-	completedItemList.rmCompleted();
+	graph.Next(completedItemList, true, procStep);
 	if (completedItemList.empty()) {
 		procStep = -1;
 		taskState = TASK_STATE_UNDEFINED;
@@ -99,7 +157,13 @@ void WarpBase::Process(std::shared_ptr<ThreadMsg> &msg, ThreadBase* thread) {
 			getProcStepString(msg->procStep), getFrameIndex(), frameImg.rows,
 			frameImg.cols);
 	if (msg->procStep == PROC_STEP_WARP) {
-		RunWarp();
+		RunWarp(cv::Range(0, geometry.height));
+	} else if (msg->procStep >= PROC_STEP_WARP_BAND
+			&& msg->procStep < PROC_STEP_WARP_BAND + bandsNum) {
+		int i = msg->procStep - PROC_STEP_WARP_BAND;
+		RunWarp(
+				cv::Range(geometry.height * i / bandsNum,
+						geometry.height * (i + 1) / bandsNum));
 	}
 	PRINT_DEBUG_MSG(DEBUG_ZONE_WARP || DEBUG_ZONE_PROCESS,
 			"--[%ld]WarpBase::Process, procStep = %s, frameIndex = %d\n",
@@ -112,6 +176,10 @@ const char* WarpBase::getProcStepString(int proc_step) {
 	case PROC_STEP_WARP:
 		return "Warp";
 	default:
+		if (proc_step >= PROC_STEP_WARP_BAND
+				&& proc_step < PROC_STEP_WARP_BAND + bandsNum) {
+			return "WarpBand";
+		}
 		return "";
 	}
 }
@@ -119,7 +187,8 @@ const char* WarpBase::getProcStepString(int proc_step) {
 ColorGradThreshBase::ColorGradThreshBase(int pipelineInstanceNum,
 		bool bParallel, bool bGpuAccel, bool bVerbose) :
 		LaneBase("ColorGradThresh", pipelineInstanceNum, bParallel, bGpuAccel,
-				bVerbose) {
+				bVerbose), bFused(false), bSparse(false), bColorLut(false), bPriorBands(
+				false), bPrior(false), bGradNorm(false), bandsNum(1) {
 	msgObjType = MSG_OBJ_TYPE_COLOR_GRAD_THRESH;
 	// Thresholds
 #if 0
@@ -148,88 +217,200 @@ void ColorGradThreshBase::Init() {
 
 void ColorGradThreshBase::Deinit() {
 	outImg.release();
+	outMask.release();
 	warpImg.release();
+	nonzero.clear();
 }
 
 void ColorGradThreshBase::setParams(LaneBase* obj) {
-	completedItemList.clear();
-	if (bParallel) { // && !bGpuAccel ?
-		completedItemList.addItem(PROC_STEP_SPLIT_BGR, TASK_STATE_INITIALIZED);
-		completedItemList.addItem(PROC_STEP_SPLIT_HLS, TASK_STATE_INITIALIZED);
-		procStep = PROC_STEP_THRESH_RED;
-	} else {
-		completedItemList.addItem(PROC_STEP_SPLIT_BGR, TASK_STATE_INITIALIZED);
-		procStep = PROC_STEP_SPLIT_BGR;
+	if (threshController) {
+		thresh = threshController->getThresholds();
+		stats.resize(bandsNum);
+		for (auto &hist : stats) {
+			hist.clear();
+		}
 	}
+	if (graph.empty()) {
+		BuildGraph();
+	}
+	graph.Start(completedItemList, bParallel || isBanded(), procStep);
 	LaneBase::setParams(obj);
 }
 
-void ColorGradThreshBase::NextStep() {
-	completedItemList.rmCompleted();
-	if (completedItemList.empty()) {
-		if (bParallel) { // && !bGpuAccel ?
-			if (procStep == PROC_STEP_THRESH_RED) {
-				completedItemList.addItem(PROC_STEP_THRESH_RED,
-						TASK_STATE_INITIALIZED);
-				completedItemList.addItem(PROC_STEP_THRESH_SAT,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_SOBEL_X;
-			} else if (procStep == PROC_STEP_SOBEL_X) {
-				completedItemList.addItem(PROC_STEP_SOBEL_X,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_THRESH_SOBEL_X;
-			} else if (procStep == PROC_STEP_THRESH_SOBEL_X) {
-				completedItemList.addItem(PROC_STEP_THRESH_SOBEL_X,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_COMB_THRESH;
-			}	else if (procStep == PROC_STEP_COMB_THRESH) {
-				completedItemList.addItem(PROC_STEP_COMB_THRESH,
-						TASK_STATE_INITIALIZED);
-				procStep = -1;
-			} else {
-				taskState = TASK_STATE_UNDEFINED;
-			}
-		} else {
-			if (procStep == PROC_STEP_SPLIT_BGR) {
-				completedItemList.addItem(PROC_STEP_THRESH_RED,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_THRESH_RED;
-			} else if (procStep == PROC_STEP_THRESH_RED) {
+void ColorGradThreshBase::BuildGraph() {
+	typedef StepGraph S;
+	if (bSparse) {
+		// Threshold in camera space and warp the surviving points only
+		graph.Add(PROC_STEP_SPARSE_THRESH);
+	} else if (isBanded()) {
+		// Every band runs the whole chain with a one row halo for the Sobel
+		// window and writes disjoint rows of the preallocated output, with a
+		// lane prior only around the predicted lanes
+		for (int i = 0; i < bandsNum; i++) {
+			graph.Add(PROC_STEP_THRESH_BAND + i);
+		}
+	} else if (bFused) {
+		// Warp and threshold in one pass, nothing follows
+		graph.Add(PROC_STEP_FUSED_THRESH);
+	} else {
+		graph.Add(PROC_STEP_SPLIT_BGR);
 #if DEBUG_ZONE_ALL_PROC_STEPS
-				completedItemList.addItem(PROC_STEP_BGR_TO_HLS,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_BGR_TO_HLS;
-
-			} else if (procStep == PROC_STEP_BGR_TO_HLS) {
+		graph.Add(PROC_STEP_BGR_TO_HLS);
+		graph.Add(PROC_STEP_SPLIT_HLS, S::Bit(PROC_STEP_BGR_TO_HLS));
+#else
+		graph.Add(PROC_STEP_SPLIT_HLS);
 #endif
-				completedItemList.addItem(PROC_STEP_SPLIT_HLS,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_SPLIT_HLS;
-			} else if (procStep == PROC_STEP_SPLIT_HLS) {
-				completedItemList.addItem(PROC_STEP_THRESH_SAT,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_THRESH_SAT;
-			} else if (procStep == PROC_STEP_THRESH_SAT) {
-				completedItemList.addItem(PROC_STEP_SOBEL_X,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_SOBEL_X;
-			} else if (procStep == PROC_STEP_SOBEL_X) {
+		// The color table fills the red mask in SplitChannel(HLS)
+		graph.Add(PROC_STEP_THRESH_RED,
+				S::Bit(PROC_STEP_SPLIT_BGR)
+						| (bColorLut ? S::Bit(PROC_STEP_SPLIT_HLS) : 0));
+		graph.Add(PROC_STEP_THRESH_SAT, S::Bit(PROC_STEP_SPLIT_HLS));
 #if DEBUG_ZONE_ALL_PROC_STEPS
-				completedItemList.addItem(PROC_STEP_ABS_SOBEL_X,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_ABS_SOBEL_X;
-			} else if (procStep == PROC_STEP_ABS_SOBEL_X) {
+		graph.Add(PROC_STEP_SOBEL_X, S::Bit(PROC_STEP_SPLIT_HLS));
+		graph.Add(PROC_STEP_ABS_SOBEL_X, S::Bit(PROC_STEP_SOBEL_X));
+		graph.Add(PROC_STEP_THRESH_SOBEL_X, S::Bit(PROC_STEP_ABS_SOBEL_X));
+		const int gradStep = PROC_STEP_THRESH_SOBEL_X;
+#else
+		graph.Add(PROC_STEP_GRAD_THRESH, S::Bit(PROC_STEP_SPLIT_HLS));
+		const int gradStep = PROC_STEP_GRAD_THRESH;
 #endif
-				completedItemList.addItem(PROC_STEP_THRESH_SOBEL_X,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_THRESH_SOBEL_X;
-			} else if (procStep == PROC_STEP_THRESH_SOBEL_X) {
-				completedItemList.addItem(PROC_STEP_COMB_THRESH,
-						TASK_STATE_INITIALIZED);
-				procStep = PROC_STEP_COMB_THRESH;
-			} else {
-				taskState = TASK_STATE_UNDEFINED;
-			}
+		graph.Add(PROC_STEP_COMB_THRESH,
+				S::Bit(PROC_STEP_THRESH_RED) | S::Bit(PROC_STEP_THRESH_SAT)
+						| S::Bit(gradStep));
+	}
+}
+
+int ColorGradThreshBase::getPriorCols(cv::Range rows,
+		cv::Range cols[2]) const {
+	cv::Rect band = geometry.getBand();
+	int s = geometry.pyramidScale;
+	int margin = cvRound(PRIOR_MARGIN * geometry.scaleX);
+	int y0 = std::max(rows.start - 1, 0);
+	int y1 = std::min(rows.end + 1, band.height);
+	for (int k = 0; k < 2; k++) {
+		const std::vector<float> &fit = priorFit[k];
+		double lo = band.width;
+		double hi = -1;
+		for (int y = y0; y < y1; y++) {
+			double u = geometry.RowToUniform(y) * s;
+			double x = (fit[0] * u * u + fit[1] * u + fit[2]) / s - band.x;
+			lo = std::min(lo, x);
+			hi = std::max(hi, x);
+		}
+		cols[k] = cv::Range(std::max(cvFloor(lo) - margin, 0),
+				std::min(cvCeil(hi) + margin + 1, band.width));
+	}
+	// Drop ranges off the band, merge overlapping ones
+	int n = 0;
+	for (int k = 0; k < 2; k++) {
+		if (cols[k].start >= cols[k].end) {
+			continue;
+		}
+		if (n > 0 && cols[k].start <= cols[0].end
+				&& cols[0].start <= cols[k].end) {
+			cols[0] = cv::Range(std::min(cols[0].start, cols[k].start),
+					std::max(cols[0].end, cols[k].end));
+		} else {
+			cols[n++] = cols[k];
+		}
+	}
+	return n;
+}
+
+void ColorGradThreshBase::FusedThresh() {
+	// The manager enables fused mode for the CPU backend only
+	PRINT_DEBUG_MSG(DEBUG_ZONE_ERROR,
+			"ColorGradThreshBase::FusedThresh error: not supported by %s\n",
+			moduleName.c_str());
+}
+
+void ColorGradThreshBase::ThreshBand(cv::Range rows, int band) {
+	// The manager splits the CPU backend only
+	PRINT_DEBUG_MSG(DEBUG_ZONE_ERROR,
+			"ColorGradThreshBase::ThreshBand error: not supported by %s\n",
+			moduleName.c_str());
+}
+
+void ColorGradThreshBase::SparseThresh() {
+	// The manager enables sparse mode for the CPU backend only
+	PRINT_DEBUG_MSG(DEBUG_ZONE_ERROR,
+			"ColorGradThreshBase::SparseThresh error: not supported by %s\n",
+			moduleName.c_str());
+}
+
+void ColorGradThreshBase::getGradBounds(int gradMax, int &lowerb,
+		int &upperb) const {
+	int lo = std::max(thresh.sobelx[0], 0);
+	int hi = thresh.sobelx[1];
+	if (lo > 255 || hi < lo) {
+		lowerb = 1;
+		upperb = 0;
+	} else if (gradMax > 0) {
+		// scaled = 255 * |g| / gradMax truncated, solved for |g|
+		lowerb = (lo * gradMax + 254) / 255;
+		upperb = hi >= 255 ? SHRT_MAX : ((hi + 1) * gradMax + 254) / 255 - 1;
+	} else {
+		// Everything from 255 up saturates to 255
+		lowerb = lo;
+		upperb = hi >= 255 ? SHRT_MAX : hi;
+	}
+}
+
+void ColorGradThreshBase::NextStep() {
+	bool bWasDone = graph.isDone();
+	graph.Next(completedItemList, bParallel || isBanded(), procStep);
+	if (completedItemList.empty()) {
+		// The manager may restore the list and retry, report once
+		if (!bWasDone) {
+			ReportDensity();
+		}
+		taskState = TASK_STATE_UNDEFINED;
+	}
+}
+
+void ColorGradThreshBase::ReportDensity() {
+	// Mask pixels of the finished frame, what the window search will scan
+	if (!threshController) {
+		return;
+	}
+	int pixels = bSparse ? (int) nonzero.size() :
+					!outMask.empty() ?
+							outMask.CountNonZero() : countNonZero(outImg);
+	for (size_t i = 1; i < stats.size(); i++) {
+		stats[0].Add(stats[i]);
+	}
+	threshController->Update(stats[0], pixels);
+}
+
+void ColorGradThreshBase::Histograms::Add(const Histograms &d) {
+	for (int v = 0; v < 256; v++) {
+		red[v] += d.red[v];
+		sat[v] += d.sat[v];
+		sobelx[v] += d.sobelx[v];
+	}
+}
+
+void ColorGradThreshBase::Histograms::Sample(const cv::Mat &plane,
+		int firstRow, int hist[256]) {
+	// Rows on a fixed grid of the mask, bands and strips sample the same
+	// rows as one pass over the whole mask
+	int y0 = (HIST_ROW_STEP - firstRow % HIST_ROW_STEP) % HIST_ROW_STEP;
+	for (int y = y0; y < plane.rows; y += HIST_ROW_STEP) {
+		const uchar* p = plane.ptr<uchar>(y);
+		for (int x = 0; x < plane.cols; x++) {
+			hist[p[x]]++;
+		}
+	}
+}
+
+void ColorGradThreshBase::Histograms::SampleAbs(const cv::Mat &grad,
+		int firstRow, int gradMax, int hist[256]) {
+	int y0 = (HIST_ROW_STEP - firstRow % HIST_ROW_STEP) % HIST_ROW_STEP;
+	for (int y = y0; y < grad.rows; y += HIST_ROW_STEP) {
+		const short* p = grad.ptr<short>(y);
+		for (int x = 0; x < grad.cols; x++) {
+			int v = std::abs(p[x]);
+			hist[gradMax > 0 ? 255 * v / gradMax : std::min(v, 255)]++;
 		}
 	}
 }
@@ -262,20 +443,37 @@ void ColorGradThreshBase::Process(std::shared_ptr<ThreadMsg> &msg,
 	} else if (msg->procStep == PROC_STEP_THRESH_SAT) {
 		// Threshold saturation channel
 		ThresholdBinary(THRESH_MODE_SAT);
+#if DEBUG_ZONE_ALL_PROC_STEPS
 	} else if (msg->procStep == PROC_STEP_SOBEL_X) {
 		// Take the derivative in x
 		Sobelx();
-#if DEBUG_ZONE_ALL_PROC_STEPS
 	} else if (msg->procStep == PROC_STEP_ABS_SOBEL_X) {
-#endif
 		// Absolute x derivative to accentuate lines away from horizontal
 		AbsSobelx();
 	} else if (msg->procStep == PROC_STEP_THRESH_SOBEL_X) {
 		// Threshold x gradient
 		ThresholdBinary(THRESH_MODE_ABS_SOBELX);
+#else
+	} else if (msg->procStep == PROC_STEP_GRAD_THRESH) {
+		// x derivative, absolute value and threshold in one pass
+		GradThresh();
+#endif
 	} else if (msg->procStep == PROC_STEP_COMB_THRESH) {
 		// Combine three binary thresholds
 		CombBinaries();
+	} else if (msg->procStep == PROC_STEP_FUSED_THRESH) {
+		// Warp, threshold and combine strip by strip
+		FusedThresh();
+	} else if (msg->procStep == PROC_STEP_SPARSE_THRESH) {
+		// Threshold the source trapezoid and warp the lane pixels
+		SparseThresh();
+	} else if (msg->procStep >= PROC_STEP_THRESH_BAND
+			&& msg->procStep < PROC_STEP_THRESH_BAND + bandsNum) {
+		// Split, threshold and combine one row band
+		int i = msg->procStep - PROC_STEP_THRESH_BAND;
+		ThreshBand(
+				cv::Range(geometry.height * i / bandsNum,
+						geometry.height * (i + 1) / bandsNum), i);
 	}
 	PRINT_DEBUG_MSG((DEBUG_ZONE_COLOR_GRAD_THRESH || DEBUG_ZONE_PROCESS),
 			"--[%ld]ColorGradThreshBase[%d]::Process, procStep = %s, frameIndex = %d\n",
@@ -297,17 +495,28 @@ const char* ColorGradThreshBase::getProcStepString(int proc_step) {
 		return "SplitHLS";
 	case PROC_STEP_THRESH_SAT:
 		return "ThreshSat";
+#if DEBUG_ZONE_ALL_PROC_STEPS
 	case PROC_STEP_SOBEL_X:
 		return "Sobelx";
-#if DEBUG_ZONE_ALL_PROC_STEPS
 	case PROC_STEP_ABS_SOBEL_X:
 		return "AbsSobelx";
-#endif
 	case PROC_STEP_THRESH_SOBEL_X:
 		return "ThreshSobelx";
+#else
+	case PROC_STEP_GRAD_THRESH:
+		return "GradThresh";
+#endif
 	case PROC_STEP_COMB_THRESH:
 		return "CombThresh";
+	case PROC_STEP_FUSED_THRESH:
+		return "FusedThresh";
+	case PROC_STEP_SPARSE_THRESH:
+		return "SparseThresh";
 	default:
+		if (proc_step >= PROC_STEP_THRESH_BAND
+				&& proc_step < PROC_STEP_THRESH_BAND + bandsNum) {
+			return "ThreshBand";
+		}
 		return "";
 	}
 }
@@ -24,6 +24,7 @@
 #include "lane_following/debug.h"
 #include "lane_following/find_lanes.h"
 #include "lane_following/lane_base.h"
+#include "lane_following/simd_kernels.h"
 #include "lane_following/thread_base.h"
 #include "lane_following/thread_manager.h"
 #include "lane_following/warp.h"
@@ -39,8 +40,10 @@ void RunWarp() {
 	img = cv::imread("frame_img.jpg", cv::IMREAD_COLOR);
 	Warp* warp = new Warp(0, false, false, false);
 	warp->setFrameImg(img);
-	warp->RunWarp();
-	out_img = warp->getOutImg();
+	warp->setParams(nullptr);
+	warp->RunWarp(cv::Range(0, warp->getGeometry().height));
+	// Arena buffers do not outlive their stage
+	out_img = warp->getOutImg().clone();
 	cv::imwrite("warped_img.jpg", out_img);
 	delete warp;
 }
@@ -130,13 +133,29 @@ void Run(tm_args *args) {
 			<< args->pipelineInstNum << std::endl;
 	std::cout << std::left << std::setw(20) << "Frames" << args->maxFrameCnt
 			<< std::endl;
+	if (!args->bGpuAccel) {
+		std::cout << std::left << std::setw(20) << "SIMD kernels"
+				<< SimdKernels::Get().getName() << std::endl;
+	}
 	std::cout << std::left << std::setw(20) << "Initialization time" << std::setw(12)
 			<< init_duration.count() << " usec" << std::endl;
 	std::cout << std::left << std::setw(20) << "Total execution time" << std::setw(12)
 			<< exec_duration.count() << " usec" << std::endl;
 	std::cout << std::left << std::setw(20) << "Avg execution time" << std::setw(12)
-			<< exec_duration.count() / args->maxFrameCnt << " usec" << std::endl
-			<< std::endl;
+			<< exec_duration.count() / args->maxFrameCnt << " usec" << std::endl;
+	if (threadManagerCuda) {
+		std::cout << std::left << std::setw(20) << "Arena misses"
+				<< threadManagerCuda->getArenaMisses() << " ("
+				<< threadManagerCuda->getSteadyArenaMisses()
+				<< " after warm-up)" << std::endl;
+	}
+	if (threadManager) {
+		std::cout << std::left << std::setw(20) << "Arena misses"
+				<< threadManager->getArenaMisses() << " ("
+				<< threadManager->getSteadyArenaMisses()
+				<< " after warm-up)" << std::endl;
+	}
+	std::cout << std::endl;
 	if (threadManagerCuda) {
 		threadManagerCuda->PrintAvgFuncDurations();
 	}
@@ -219,6 +238,7 @@ int main(int argc, char** argv) {
 	args.bVerbose = true;
 	args.bGpuAccel = true;
 	args.bParallel = true;
+	args.bRemap = !args.bGpuAccel; // CPU only
 	Run(&args);
 	return 0;
 #endif
@@ -0,0 +1,102 @@
+#include "lane_following/mat_arena.h"
+
+#include <opencv2/core.hpp>
+
+MatArena::MatArena() :
+		misses(0), reuses(0) {
+}
+
+MatArena::~MatArena() {
+	for (auto &block : freeBlocks) {
+		cv::fastFree(block.second->origdata);
+		delete block.second;
+	}
+}
+
+cv::UMatData* MatArena::allocate(int dims, const int* sizes, int type,
+		void* data, size_t* step, AccessFlag flags,
+		cv::UMatUsageFlags usageFlags) const {
+	// Same layout as the default allocator, continuous rows
+	size_t total = CV_ELEM_SIZE(type);
+	for (int i = dims - 1; i >= 0; i--) {
+		if (step) {
+			if (data && step[i] != CV_AUTOSTEP) {
+				CV_Assert(total <= step[i]);
+				total = step[i];
+			} else {
+				step[i] = total;
+			}
+		}
+		total *= sizes[i];
+	}
+	if (data) {
+		// User memory is wrapped, never pooled
+		cv::UMatData* u = new cv::UMatData(this);
+		u->data = u->origdata = (uchar*) data;
+		u->size = total;
+		u->flags |= cv::UMatData::USER_ALLOCATED;
+		return u;
+	}
+	size_t capacity = SizeClass(total);
+	cv::UMatData* u = nullptr;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto it = freeBlocks.find(capacity);
+		if (it != freeBlocks.end()) {
+			u = it->second;
+			freeBlocks.erase(it);
+			reuses++;
+		} else {
+			misses++;
+		}
+	}
+	if (!u) {
+		u = new cv::UMatData(this);
+		u->origdata = (uchar*) cv::fastMalloc(capacity);
+	}
+	u->data = u->origdata;
+	u->size = total;
+	return u;
+}
+
+bool MatArena::allocate(cv::UMatData* u, AccessFlag accessFlags,
+		cv::UMatUsageFlags usageFlags) const {
+	return u != nullptr;
+}
+
+void MatArena::deallocate(cv::UMatData* u) const {
+	if (!u) {
+		return;
+	}
+	CV_Assert(u->urefcount == 0 && u->refcount == 0);
+	if (u->flags & cv::UMatData::USER_ALLOCATED) {
+		delete u;
+		return;
+	}
+	std::lock_guard<std::mutex> guard(lock);
+	freeBlocks.emplace(SizeClass(u->size), u);
+}
+
+uint64_t MatArena::getMisses() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return misses;
+}
+
+uint64_t MatArena::getReuses() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return reuses;
+}
+
+size_t MatArena::SizeClass(size_t size) {
+	// Round up to a quarter of the enclosing power of two, at most 25% is
+	// wasted
+	if (size <= 256) {
+		return 256;
+	}
+	int bits = 0;
+	while (((size_t) 1 << bits) < size) {
+		bits++;
+	}
+	size_t quarter = (size_t) 1 << (bits - 3);
+	return (size + quarter - 1) / quarter * quarter;
+}
@@ -0,0 +1,55 @@
+#include "lane_following/quad_fit.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Relative determinant below which the system counts as singular
+const double SINGULAR_EPS = 1e-12;
+
+}
+
+void QuadFit::setRange(double yMin, double yMax) {
+	center = (yMin + yMax) / 2;
+	scale = std::max((yMax - yMin) / 2, 1.0);
+}
+
+void QuadFit::clear() {
+	std::fill(s, s + 5, 0.0);
+	std::fill(r, r + 3, 0.0);
+}
+
+void QuadFit::Solve(std::vector<float> &fit) const {
+	// Coefficients of a * t^2 + b * t + d
+	double a = 0;
+	double b = 0;
+	double d = s[0] > 0 ? r[0] / s[0] : 0;
+	// Cofactors of the symmetric normal matrix
+	// | s4 s3 s2 |
+	// | s3 s2 s1 |
+	// | s2 s1 s0 |
+	double c00 = s[2] * s[0] - s[1] * s[1];
+	double c01 = s[1] * s[2] - s[3] * s[0];
+	double c02 = s[3] * s[1] - s[2] * s[2];
+	double c11 = s[4] * s[0] - s[2] * s[2];
+	double c12 = s[3] * s[2] - s[4] * s[1];
+	double c22 = s[4] * s[2] - s[3] * s[3];
+	double det = s[4] * c00 + s[3] * c01 + s[2] * c02;
+	if (std::abs(det) > SINGULAR_EPS * s[4] * s[2] * s[0]) {
+		a = (c00 * r[2] + c01 * r[1] + c02 * r[0]) / det;
+		b = (c01 * r[2] + c11 * r[1] + c12 * r[0]) / det;
+		d = (c02 * r[2] + c12 * r[1] + c22 * r[0]) / det;
+	} else if (std::abs(c00) > SINGULAR_EPS * s[2] * s[0]) {
+		// Two distinct y, a line
+		b = (s[0] * r[1] - s[1] * r[0]) / c00;
+		d = (r[0] - b * s[1]) / s[0];
+	}
+	// Back to y, t = (y - center) / scale
+	double A = a / (scale * scale);
+	double B = b / scale;
+	fit.resize(3);
+	fit[0] = A;
+	fit[1] = B - 2 * A * center;
+	fit[2] = (A * center - B) * center + d;
+}
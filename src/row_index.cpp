@@ -0,0 +1,59 @@
+#include "lane_following/row_index.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "lane_following/bit_mask.h"
+
+void RowIndex::Build(const BitMask &mask, int histRow,
+		std::vector<int> &hist) {
+	// Buffers keep their capacity from frame to frame, no presizing pass
+	rows = mask.size().height;
+	int wordsPerRow = mask.getWordsPerRow();
+	xs.clear();
+	rowStart.assign(1, 0);
+	hist.assign(mask.size().width, 0);
+	for (int y = rows - 1; y >= 0; y--) {
+		const uint64_t* w = mask.row(y);
+		bool bHist = y >= histRow;
+		for (int i = 0; i < wordsPerRow; i++) {
+			uint64_t bits = w[i];
+			while (bits) {
+				int x = i * 64 + __builtin_ctzll(bits);
+				xs.push_back(x);
+				if (bHist) {
+					hist[x]++;
+				}
+				bits &= bits - 1;
+			}
+		}
+		rowStart.push_back(xs.size());
+	}
+}
+
+void RowIndex::Build(const std::vector<cv::Point> &pts, cv::Size size,
+		int histRow, std::vector<int> &hist) {
+	rows = size.height;
+	xs.clear();
+	rowStart.assign(1, 0);
+	hist.assign(size.width, 0);
+	size_t i = 0;
+	for (int y = rows - 1; y >= 0; y--) {
+		size_t first = xs.size();
+		for (; i < pts.size() && pts[i].y == y; i++) {
+			xs.push_back(pts[i].x);
+			if (y >= histRow) {
+				hist[pts[i].x]++;
+			}
+		}
+		// Points of a row come right to left
+		std::reverse(xs.begin() + first, xs.end());
+		rowStart.push_back(xs.size());
+	}
+}
+
+void RowIndex::clear() {
+	rows = 0;
+	xs.clear();
+	rowStart.clear();
+}
@@ -0,0 +1,91 @@
+#include "lane_following/row_prefix.h"
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+
+#include "lane_following/bit_mask.h"
+#include "lane_following/row_index.h"
+
+void RowPrefix::Build(const BitMask &mask, int histRow,
+		std::vector<int> &hist) {
+	rows = mask.size().height;
+	cols = mask.size().width;
+	CV_Assert(cols < 65536);
+	size_t stride = cols + 1;
+	count.resize(rows * stride);
+	sumX.resize(rows * stride);
+	hist.assign(cols, 0);
+	for (int y = 0; y < rows; y++) {
+		const uint64_t* w = mask.row(y);
+		uint16_t* c = count.data() + y * stride;
+		int32_t* s = sumX.data() + y * stride;
+		bool bHist = y >= histRow;
+		int n = 0;
+		int sum = 0;
+		c[0] = 0;
+		s[0] = 0;
+		// Branch-free, the cost depends on the width only
+		for (int x = 0; x < cols; x++) {
+			int bit = (int) (w[x >> 6] >> (x & 63)) & 1;
+			n += bit;
+			sum += x & -bit;
+			c[x + 1] = n;
+			s[x + 1] = sum;
+			if (bHist) {
+				hist[x] += bit;
+			}
+		}
+	}
+}
+
+void RowPrefix::Build(const RowIndex &index, int cols) {
+	rows = index.getRows();
+	this->cols = cols;
+	CV_Assert(cols < 65536);
+	size_t stride = cols + 1;
+	count.resize(rows * stride);
+	sumX.resize(rows * stride);
+	for (int y = 0; y < rows; y++) {
+		uint16_t* c = count.data() + y * stride;
+		int32_t* s = sumX.data() + y * stride;
+		const short* p = index.begin(y);
+		int n = 0;
+		int sum = 0;
+		c[0] = 0;
+		s[0] = 0;
+		for (int x = 0; x < cols; x++) {
+			// Ascending within the row, at most one point per column
+			if (p < index.end(y) && *p == x) {
+				n++;
+				sum += x;
+				p++;
+			}
+			c[x + 1] = n;
+			s[x + 1] = sum;
+		}
+	}
+}
+
+void RowPrefix::clear() {
+	rows = cols = 0;
+	count.clear();
+	sumX.clear();
+}
+
+void RowPrefix::Window(cv::Range rowRange, cv::Range colRange, int &num,
+		int &xSum, int &ySum) const {
+	int y0 = std::max(rowRange.start, 0);
+	int y1 = std::min(rowRange.end, rows);
+	int x0 = std::min(std::max(colRange.start, 0), cols);
+	int x1 = std::min(std::max(colRange.end, 0), cols);
+	size_t stride = cols + 1;
+	num = xSum = ySum = 0;
+	for (int y = y0; y < y1 && x0 < x1; y++) {
+		const uint16_t* c = count.data() + y * stride;
+		const int32_t* s = sumX.data() + y * stride;
+		int n = c[x1] - c[x0];
+		num += n;
+		xSum += s[x1] - s[x0];
+		ySum += y * n;
+	}
+}
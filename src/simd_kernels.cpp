@@ -0,0 +1,1175 @@
+#include "lane_following/simd_kernels.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "lane_following/bit_mask.h"
+#include "lane_following/debug.h"
+
+// Lightness and saturation must round exactly like cvtColor, keep the
+// compiler from fusing their multiplies and adds
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace {
+
+// Bilinear weights of WarpMaps, INTER_BITS fractional bits per axis
+enum {
+	REMAP_BITS = cv::INTER_BITS,
+	REMAP_TAB = 1 << REMAP_BITS,
+	REMAP_SHIFT = 2 * REMAP_BITS
+};
+
+void ExtractChannelScalar(const uchar* src, int channel, uchar* dst,
+		int len) {
+	for (int i = 0; i < len; i++) {
+		dst[i] = src[i * 3 + channel];
+	}
+}
+
+void InRangeScalar(const uchar* src, uchar lowerb, uchar upperb, uchar* dst,
+		int len) {
+	for (int i = 0; i < len; i++) {
+		dst[i] = (src[i] >= lowerb && src[i] <= upperb) ? 255 : 0;
+	}
+}
+
+void InRangeBitsScalar(const uchar* src, uchar lowerb, uchar upperb,
+		uchar* dst, int len) {
+	for (int i = 0; i < len; i += 8) {
+		int n = std::min(8, len - i);
+		uchar bits = 0;
+		for (int k = 0; k < n; k++) {
+			bits |= (src[i + k] >= lowerb && src[i + k] <= upperb) << k;
+		}
+		dst[i >> 3] = bits;
+	}
+}
+
+void PackMaskScalar(const uchar* src, uchar* dst, int len) {
+	for (int i = 0; i < len; i += 8) {
+		int n = std::min(8, len - i);
+		uchar bits = 0;
+		for (int k = 0; k < n; k++) {
+			bits |= (src[i + k] != 0) << k;
+		}
+		dst[i >> 3] = bits;
+	}
+}
+
+void CombMaskScalar(const uchar* sat, const uchar* sobelx, const uchar* red,
+		uchar* dst, int len) {
+	for (int i = 0; i < len; i++) {
+		dst[i] = sat[i] | (sobelx[i] & red[i]);
+	}
+}
+
+void AbsInRangeBitsScalar(const short* src, short lowerb, short upperb,
+		uchar* dst, int len) {
+	for (int i = 0; i < len; i += 8) {
+		int n = std::min(8, len - i);
+		uchar bits = 0;
+		for (int k = 0; k < n; k++) {
+			int v = std::abs(src[i + k]);
+			bits |= (v >= lowerb && v <= upperb) << k;
+		}
+		dst[i >> 3] = bits;
+	}
+}
+
+// 3x3 Sobel x-derivative of the middle row, the default border reflects
+// column -1 to 1 and column len to len - 2, so both edge columns are 0
+inline int SobelxPixel(const uchar* r0, const uchar* r1, const uchar* r2,
+		int x, int len) {
+	int xl = x > 0 ? x - 1 : std::min(1, len - 1);
+	int xr = x < len - 1 ? x + 1 : std::max(len - 2, 0);
+	return r0[xr] - r0[xl] + 2 * (r1[xr] - r1[xl]) + r2[xr] - r2[xl];
+}
+
+// Pixels begin to end of a row, begin is a multiple of 8
+void SobelxThreshBitsRange(const uchar* r0, const uchar* r1, const uchar* r2,
+		short lowerb, short upperb, uchar* dst, int len, int begin, int end) {
+	for (int i = begin; i < end; i += 8) {
+		int n = std::min(8, end - i);
+		uchar bits = 0;
+		for (int k = 0; k < n; k++) {
+			int v = std::abs(SobelxPixel(r0, r1, r2, i + k, len));
+			bits |= (v >= lowerb && v <= upperb) << k;
+		}
+		dst[i >> 3] = bits;
+	}
+}
+
+void SobelxThreshBitsScalar(const uchar* r0, const uchar* r1, const uchar* r2,
+		short lowerb, short upperb, uchar* dst, int len) {
+	SobelxThreshBitsRange(r0, r1, r2, lowerb, upperb, dst, len, 0, len);
+}
+
+inline void RemapPixel(const uchar* src, size_t step, int rows, int cols,
+		int sx, int sy, int a, uchar* dst) {
+	int fx = a & (REMAP_TAB - 1);
+	int fy = a >> REMAP_BITS;
+	int w[4] = { (REMAP_TAB - fx) * (REMAP_TAB - fy), fx * (REMAP_TAB - fy),
+			(REMAP_TAB - fx) * fy, fx * fy };
+	int sum[3] = { 1 << (REMAP_SHIFT - 1), 1 << (REMAP_SHIFT - 1), 1
+			<< (REMAP_SHIFT - 1) };
+	for (int k = 0; k < 4; k++) {
+		int x = sx + (k & 1);
+		int y = sy + (k >> 1);
+		// Constant zero border
+		if (x < 0 || x >= cols || y < 0 || y >= rows) {
+			continue;
+		}
+		const uchar* p = src + y * step + x * 3;
+		sum[0] += w[k] * p[0];
+		sum[1] += w[k] * p[1];
+		sum[2] += w[k] * p[2];
+	}
+	dst[0] = (uchar) (sum[0] >> REMAP_SHIFT);
+	dst[1] = (uchar) (sum[1] >> REMAP_SHIFT);
+	dst[2] = (uchar) (sum[2] >> REMAP_SHIFT);
+}
+
+void RemapScalar(const uchar* src, size_t step, int rows, int cols,
+		const short* xy, const ushort* a, uchar* dst, int len) {
+	for (int i = 0; i < len; i++) {
+		RemapPixel(src, step, rows, cols, xy[i * 2], xy[i * 2 + 1], a[i],
+				dst + i * 3);
+	}
+}
+
+// Lightness and saturation in the float operations cvtColor(BGR2HLS) uses,
+// in its order: the denominator above half lightness is (2 - max) - min,
+// rounding 2 - (max + min) instead moves saturation by one for some pairs.
+// The vector variants repeat them lane by lane.
+inline void LigSatPixel(int vmax, int vmin, uchar* lig, uchar* sat) {
+	const float k = 1.f / 255;
+	float fmax = vmax * k;
+	float fmin = vmin * k;
+	float sum = fmax + fmin;
+	float diff = fmax - fmin;
+	float l = sum * 0.5f;
+	float s = diff > FLT_EPSILON ?
+			diff / (l < 0.5f ? sum : (2.f - fmax) - fmin) : 0.f;
+	*lig = (uchar) std::lrint(l * 255);
+	*sat = (uchar) std::lrint(s * 255);
+}
+
+void LigSatRedScalar(const uchar* bgr, uchar* lig, uchar* sat, uchar* red,
+		int len) {
+	for (int i = 0; i < len; i++) {
+		const uchar* p = bgr + i * 3;
+		int vmax = std::max(std::max(p[0], p[1]), p[2]);
+		int vmin = std::min(std::min(p[0], p[1]), p[2]);
+		LigSatPixel(vmax, vmin, lig + i, sat + i);
+		if (red) {
+			red[i] = p[2];
+		}
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// pshufb masks gathering one channel of 16 interleaved pixels from the
+// three 16 byte blocks they span
+void DeinterleaveMasks(int channel, uchar masks[3][16]) {
+	for (int k = 0; k < 3; k++) {
+		for (int j = 0; j < 16; j++) {
+			int pos = j * 3 + channel - k * 16;
+			masks[k][j] = (pos >= 0 && pos < 16) ? pos : 0x80;
+		}
+	}
+}
+
+// Packs the low three bytes of every dword, per 128 bit lane
+const char PACK_RGB[16] = { 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1,
+		-1, -1 };
+
+__attribute__((target("sse4.2")))
+void ExtractChannelSSE42(const uchar* src, int channel, uchar* dst, int len) {
+	uchar masks[3][16];
+	DeinterleaveMasks(channel, masks);
+	__m128i m0 = _mm_loadu_si128((const __m128i*) masks[0]);
+	__m128i m1 = _mm_loadu_si128((const __m128i*) masks[1]);
+	__m128i m2 = _mm_loadu_si128((const __m128i*) masks[2]);
+	int i = 0;
+	for (; i + 16 <= len; i += 16) {
+		const uchar* s = src + i * 3;
+		__m128i v0 = _mm_loadu_si128((const __m128i*) s);
+		__m128i v1 = _mm_loadu_si128((const __m128i*) (s + 16));
+		__m128i v2 = _mm_loadu_si128((const __m128i*) (s + 32));
+		__m128i r = _mm_or_si128(
+				_mm_or_si128(_mm_shuffle_epi8(v0, m0),
+						_mm_shuffle_epi8(v1, m1)), _mm_shuffle_epi8(v2, m2));
+		_mm_storeu_si128((__m128i*) (dst + i), r);
+	}
+	ExtractChannelScalar(src + i * 3, channel, dst + i, len - i);
+}
+
+__attribute__((target("sse4.2")))
+void InRangeSSE42(const uchar* src, uchar lowerb, uchar upperb, uchar* dst,
+		int len) {
+	__m128i lo = _mm_set1_epi8((char) lowerb);
+	__m128i hi = _mm_set1_epi8((char) upperb);
+	int i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(v, lo), v);
+		__m128i le = _mm_cmpeq_epi8(_mm_min_epu8(v, hi), v);
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_and_si128(ge, le));
+	}
+	InRangeScalar(src + i, lowerb, upperb, dst + i, len - i);
+}
+
+__attribute__((target("sse4.2")))
+void InRangeBitsSSE42(const uchar* src, uchar lowerb, uchar upperb,
+		uchar* dst, int len) {
+	__m128i lo = _mm_set1_epi8((char) lowerb);
+	__m128i hi = _mm_set1_epi8((char) upperb);
+	int i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(v, lo), v);
+		__m128i le = _mm_cmpeq_epi8(_mm_min_epu8(v, hi), v);
+		uint16_t bits = (uint16_t) _mm_movemask_epi8(_mm_and_si128(ge, le));
+		memcpy(dst + (i >> 3), &bits, sizeof(bits));
+	}
+	InRangeBitsScalar(src + i, lowerb, upperb, dst + (i >> 3), len - i);
+}
+
+__attribute__((target("sse4.2")))
+void PackMaskSSE42(const uchar* src, uchar* dst, int len) {
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		uint16_t bits = (uint16_t) ~_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+		memcpy(dst + (i >> 3), &bits, sizeof(bits));
+	}
+	PackMaskScalar(src + i, dst + (i >> 3), len - i);
+}
+
+__attribute__((target("sse4.2")))
+void CombMaskSSE42(const uchar* sat, const uchar* sobelx, const uchar* red,
+		uchar* dst, int len) {
+	int i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i s = _mm_loadu_si128((const __m128i*) (sat + i));
+		__m128i g = _mm_loadu_si128((const __m128i*) (sobelx + i));
+		__m128i r = _mm_loadu_si128((const __m128i*) (red + i));
+		_mm_storeu_si128((__m128i*) (dst + i),
+				_mm_or_si128(s, _mm_and_si128(g, r)));
+	}
+	CombMaskScalar(sat + i, sobelx + i, red + i, dst + i, len - i);
+}
+
+// All-ones 16-bit lanes where lowerb <= |v| <= upperb
+__attribute__((target("sse4.2")))
+inline __m128i AbsInRangeSSE42(__m128i v, __m128i lo, __m128i hi) {
+	v = _mm_abs_epi16(v);
+	return _mm_and_si128(_mm_cmpeq_epi16(_mm_max_epi16(v, lo), v),
+			_mm_cmpeq_epi16(_mm_min_epi16(v, hi), v));
+}
+
+__attribute__((target("sse4.2")))
+void AbsInRangeBitsSSE42(const short* src, short lowerb, short upperb,
+		uchar* dst, int len) {
+	__m128i lo = _mm_set1_epi16(lowerb);
+	__m128i hi = _mm_set1_epi16(upperb);
+	int i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i m0 = AbsInRangeSSE42(
+				_mm_loadu_si128((const __m128i*) (src + i)), lo, hi);
+		__m128i m1 = AbsInRangeSSE42(
+				_mm_loadu_si128((const __m128i*) (src + i + 8)), lo, hi);
+		uint16_t bits = (uint16_t) _mm_movemask_epi8(_mm_packs_epi16(m0, m1));
+		memcpy(dst + (i >> 3), &bits, sizeof(bits));
+	}
+	AbsInRangeBitsScalar(src + i, lowerb, upperb, dst + (i >> 3), len - i);
+}
+
+// Sobel x-derivative of eight pixels from x, x - 1 and x + 1 in the image
+__attribute__((target("sse4.2")))
+inline __m128i SobelxSSE42(const uchar* r0, const uchar* r1, const uchar* r2,
+		int x) {
+	auto diff = [x](const uchar* r) {
+		return _mm_sub_epi16(
+				_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*) (r + x + 1))),
+				_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*) (r + x - 1))));
+	};
+	__m128i d1 = diff(r1);
+	return _mm_add_epi16(_mm_add_epi16(diff(r0), diff(r2)),
+			_mm_add_epi16(d1, d1));
+}
+
+__attribute__((target("sse4.2")))
+void SobelxThreshBitsSSE42(const uchar* r0, const uchar* r1, const uchar* r2,
+		short lowerb, short upperb, uchar* dst, int len) {
+	__m128i lo = _mm_set1_epi16(lowerb);
+	__m128i hi = _mm_set1_epi16(upperb);
+	// The first block holds the left border, the loads of a block reach
+	// one pixel past it on both sides
+	int i = std::min(16, len);
+	SobelxThreshBitsRange(r0, r1, r2, lowerb, upperb, dst, len, 0, i);
+	for (; i + 17 <= len; i += 16) {
+		__m128i m0 = AbsInRangeSSE42(SobelxSSE42(r0, r1, r2, i), lo, hi);
+		__m128i m1 = AbsInRangeSSE42(SobelxSSE42(r0, r1, r2, i + 8), lo, hi);
+		uint16_t bits = (uint16_t) _mm_movemask_epi8(_mm_packs_epi16(m0, m1));
+		memcpy(dst + (i >> 3), &bits, sizeof(bits));
+	}
+	SobelxThreshBitsRange(r0, r1, r2, lowerb, upperb, dst, len, i, len);
+}
+
+__attribute__((target("sse4.2")))
+inline void LigSatSSE42(__m128i vmax, __m128i vmin, __m128i &lig,
+		__m128i &sat) {
+	const __m128 k = _mm_set1_ps(1.f / 255);
+	__m128 fmax = _mm_mul_ps(_mm_cvtepi32_ps(vmax), k);
+	__m128 fmin = _mm_mul_ps(_mm_cvtepi32_ps(vmin), k);
+	__m128 sum = _mm_add_ps(fmax, fmin);
+	__m128 diff = _mm_sub_ps(fmax, fmin);
+	__m128 l = _mm_mul_ps(sum, _mm_set1_ps(0.5f));
+	__m128 den = _mm_blendv_ps(
+			_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(2.f), fmax), fmin), sum,
+			_mm_cmplt_ps(l, _mm_set1_ps(0.5f)));
+	__m128 s = _mm_and_ps(_mm_div_ps(diff, den),
+			_mm_cmpgt_ps(diff, _mm_set1_ps(FLT_EPSILON)));
+	lig = _mm_cvtps_epi32(_mm_mul_ps(l, _mm_set1_ps(255.f)));
+	sat = _mm_cvtps_epi32(_mm_mul_ps(s, _mm_set1_ps(255.f)));
+}
+
+__attribute__((target("sse4.2")))
+void LigSatRedSSE42(const uchar* bgr, uchar* lig, uchar* sat, uchar* red,
+		int len) {
+	uchar masks[3][3][16];
+	__m128i m[3][3];
+	for (int c = 0; c < 3; c++) {
+		DeinterleaveMasks(c, masks[c]);
+		for (int k = 0; k < 3; k++) {
+			m[c][k] = _mm_loadu_si128((const __m128i*) masks[c][k]);
+		}
+	}
+	int i = 0;
+	for (; i + 16 <= len; i += 16) {
+		const uchar* s = bgr + i * 3;
+		__m128i v[3] = { _mm_loadu_si128((const __m128i*) s), _mm_loadu_si128(
+				(const __m128i*) (s + 16)), _mm_loadu_si128(
+				(const __m128i*) (s + 32)) };
+		__m128i ch[3];
+		for (int c = 0; c < 3; c++) {
+			ch[c] = _mm_or_si128(
+					_mm_or_si128(_mm_shuffle_epi8(v[0], m[c][0]),
+							_mm_shuffle_epi8(v[1], m[c][1])),
+					_mm_shuffle_epi8(v[2], m[c][2]));
+		}
+		if (red) {
+			_mm_storeu_si128((__m128i*) (red + i), ch[2]);
+		}
+		__m128i vmax = _mm_max_epu8(_mm_max_epu8(ch[0], ch[1]), ch[2]);
+		__m128i vmin = _mm_min_epu8(_mm_min_epu8(ch[0], ch[1]), ch[2]);
+		__m128i l[4], t[4];
+		LigSatSSE42(_mm_cvtepu8_epi32(vmax), _mm_cvtepu8_epi32(vmin), l[0],
+				t[0]);
+		LigSatSSE42(_mm_cvtepu8_epi32(_mm_srli_si128(vmax, 4)),
+				_mm_cvtepu8_epi32(_mm_srli_si128(vmin, 4)), l[1], t[1]);
+		LigSatSSE42(_mm_cvtepu8_epi32(_mm_srli_si128(vmax, 8)),
+				_mm_cvtepu8_epi32(_mm_srli_si128(vmin, 8)), l[2], t[2]);
+		LigSatSSE42(_mm_cvtepu8_epi32(_mm_srli_si128(vmax, 12)),
+				_mm_cvtepu8_epi32(_mm_srli_si128(vmin, 12)), l[3], t[3]);
+		_mm_storeu_si128((__m128i*) (lig + i),
+				_mm_packus_epi16(_mm_packus_epi32(l[0], l[1]),
+						_mm_packus_epi32(l[2], l[3])));
+		_mm_storeu_si128((__m128i*) (sat + i),
+				_mm_packus_epi16(_mm_packus_epi32(t[0], t[1]),
+						_mm_packus_epi32(t[2], t[3])));
+	}
+	LigSatRedScalar(bgr + i * 3, lig + i, sat + i, red ? red + i : nullptr,
+			len - i);
+}
+
+// Consecutive 48 byte blocks (16 pixels) into consecutive 128 bit lanes
+__attribute__((target("avx2")))
+inline __m256i LoadLanesAVX2(const uchar* s) {
+	return _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) s)),
+			_mm_loadu_si128((const __m128i*) (s + 48)), 1);
+}
+
+__attribute__((target("avx2")))
+void ExtractChannelAVX2(const uchar* src, int channel, uchar* dst, int len) {
+	// Each 128 bit lane deinterleaves its own 16 pixels
+	uchar masks[3][16];
+	DeinterleaveMasks(channel, masks);
+	__m256i m0 = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i*) masks[0]));
+	__m256i m1 = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i*) masks[1]));
+	__m256i m2 = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i*) masks[2]));
+	int i = 0;
+	for (; i + 32 <= len; i += 32) {
+		const uchar* s = src + i * 3;
+		__m256i r = _mm256_or_si256(
+				_mm256_or_si256(_mm256_shuffle_epi8(LoadLanesAVX2(s), m0),
+						_mm256_shuffle_epi8(LoadLanesAVX2(s + 16), m1)),
+				_mm256_shuffle_epi8(LoadLanesAVX2(s + 32), m2));
+		_mm256_storeu_si256((__m256i*) (dst + i), r);
+	}
+	ExtractChannelSSE42(src + i * 3, channel, dst + i, len - i);
+}
+
+__attribute__((target("avx2")))
+void InRangeAVX2(const uchar* src, uchar lowerb, uchar upperb, uchar* dst,
+		int len) {
+	__m256i lo = _mm256_set1_epi8((char) lowerb);
+	__m256i hi = _mm256_set1_epi8((char) upperb);
+	int i = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+		__m256i ge = _mm256_cmpeq_epi8(_mm256_max_epu8(v, lo), v);
+		__m256i le = _mm256_cmpeq_epi8(_mm256_min_epu8(v, hi), v);
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_and_si256(ge, le));
+	}
+	InRangeSSE42(src + i, lowerb, upperb, dst + i, len - i);
+}
+
+__attribute__((target("avx2")))
+void InRangeBitsAVX2(const uchar* src, uchar lowerb, uchar upperb, uchar* dst,
+		int len) {
+	__m256i lo = _mm256_set1_epi8((char) lowerb);
+	__m256i hi = _mm256_set1_epi8((char) upperb);
+	int i = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+		__m256i ge = _mm256_cmpeq_epi8(_mm256_max_epu8(v, lo), v);
+		__m256i le = _mm256_cmpeq_epi8(_mm256_min_epu8(v, hi), v);
+		uint32_t bits = (uint32_t) _mm256_movemask_epi8(
+				_mm256_and_si256(ge, le));
+		memcpy(dst + (i >> 3), &bits, sizeof(bits));
+	}
+	InRangeBitsSSE42(src + i, lowerb, upperb, dst + (i >> 3), len - i);
+}
+
+__attribute__((target("avx2")))
+void PackMaskAVX2(const uchar* src, uchar* dst, int len) {
+	const __m256i zero = _mm256_setzero_si256();
+	int i = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+		uint32_t bits = ~(uint32_t) _mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(v, zero));
+		memcpy(dst + (i >> 3), &bits, sizeof(bits));
+	}
+	PackMaskSSE42(src + i, dst + (i >> 3), len - i);
+}
+
+__attribute__((target("avx2")))
+void CombMaskAVX2(const uchar* sat, const uchar* sobelx, const uchar* red,
+		uchar* dst, int len) {
+	int i = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i s = _mm256_loadu_si256((const __m256i*) (sat + i));
+		__m256i g = _mm256_loadu_si256((const __m256i*) (sobelx + i));
+		__m256i r = _mm256_loadu_si256((const __m256i*) (red + i));
+		_mm256_storeu_si256((__m256i*) (dst + i),
+				_mm256_or_si256(s, _mm256_and_si256(g, r)));
+	}
+	CombMaskSSE42(sat + i, sobelx + i, red + i, dst + i, len - i);
+}
+
+__attribute__((target("avx2")))
+inline __m256i AbsInRangeAVX2(__m256i v, __m256i lo, __m256i hi) {
+	v = _mm256_abs_epi16(v);
+	return _mm256_and_si256(_mm256_cmpeq_epi16(_mm256_max_epi16(v, lo), v),
+			_mm256_cmpeq_epi16(_mm256_min_epi16(v, hi), v));
+}
+
+// 32 lane masks to 32 bits, packs interleaves the 128 bit lanes
+__attribute__((target("avx2")))
+inline uint32_t MaskBitsAVX2(__m256i m0, __m256i m1) {
+	return (uint32_t) _mm256_movemask_epi8(
+			_mm256_permute4x64_epi64(_mm256_packs_epi16(m0, m1), 0xd8));
+}
+
+__attribute__((target("avx2")))
+void AbsInRangeBitsAVX2(const short* src, short lowerb, short upperb,
+		uchar* dst, int len) {
+	__m256i lo = _mm256_set1_epi16(lowerb);
+	__m256i hi = _mm256_set1_epi16(upperb);
+	int i = 0;
+	for (; i + 32 <= len; i += 32) {
+		uint32_t bits = MaskBitsAVX2(
+				AbsInRangeAVX2(_mm256_loadu_si256((const __m256i*) (src + i)),
+						lo, hi),
+				AbsInRangeAVX2(
+						_mm256_loadu_si256((const __m256i*) (src + i + 16)),
+						lo, hi));
+		memcpy(dst + (i >> 3), &bits, sizeof(bits));
+	}
+	AbsInRangeBitsSSE42(src + i, lowerb, upperb, dst + (i >> 3), len - i);
+}
+
+__attribute__((target("avx2")))
+inline __m256i SobelxAVX2(const uchar* r0, const uchar* r1, const uchar* r2,
+		int x) {
+	auto diff = [x](const uchar* r) {
+		return _mm256_sub_epi16(
+				_mm256_cvtepu8_epi16(
+						_mm_loadu_si128((const __m128i*) (r + x + 1))),
+				_mm256_cvtepu8_epi16(
+						_mm_loadu_si128((const __m128i*) (r + x - 1))));
+	};
+	__m256i d1 = diff(r1);
+	return _mm256_add_epi16(_mm256_add_epi16(diff(r0), diff(r2)),
+			_mm256_add_epi16(d1, d1));
+}
+
+__attribute__((target("avx2")))
+void SobelxThreshBitsAVX2(const uchar* r0, const uchar* r1, const uchar* r2,
+		short lowerb, short upperb, uchar* dst, int len) {
+	__m256i lo = _mm256_set1_epi16(lowerb);
+	__m256i hi = _mm256_set1_epi16(upperb);
+	int i = std::min(32, len);
+	SobelxThreshBitsRange(r0, r1, r2, lowerb, upperb, dst, len, 0, i);
+	for (; i + 33 <= len; i += 32) {
+		uint32_t bits = MaskBitsAVX2(
+				AbsInRangeAVX2(SobelxAVX2(r0, r1, r2, i), lo, hi),
+				AbsInRangeAVX2(SobelxAVX2(r0, r1, r2, i + 16), lo, hi));
+		memcpy(dst + (i >> 3), &bits, sizeof(bits));
+	}
+	SobelxThreshBitsRange(r0, r1, r2, lowerb, upperb, dst, len, i, len);
+}
+
+// Eight lightness and saturation values from eight vmax, vmin bytes
+__attribute__((target("avx2")))
+inline void LigSatAVX2(__m128i vmax, __m128i vmin, uchar* lig, uchar* sat) {
+	const __m256 k = _mm256_set1_ps(1.f / 255);
+	__m256 fmax = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(vmax)),
+			k);
+	__m256 fmin = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(vmin)),
+			k);
+	__m256 sum = _mm256_add_ps(fmax, fmin);
+	__m256 diff = _mm256_sub_ps(fmax, fmin);
+	__m256 l = _mm256_mul_ps(sum, _mm256_set1_ps(0.5f));
+	__m256 den = _mm256_blendv_ps(
+			_mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(2.f), fmax), fmin), sum,
+			_mm256_cmp_ps(l, _mm256_set1_ps(0.5f), _CMP_LT_OQ));
+	__m256 s = _mm256_and_ps(_mm256_div_ps(diff, den),
+			_mm256_cmp_ps(diff, _mm256_set1_ps(FLT_EPSILON), _CMP_GT_OQ));
+	__m256i li = _mm256_cvtps_epi32(_mm256_mul_ps(l, _mm256_set1_ps(255.f)));
+	__m256i si = _mm256_cvtps_epi32(_mm256_mul_ps(s, _mm256_set1_ps(255.f)));
+	__m128i l16 = _mm_packus_epi32(_mm256_castsi256_si128(li),
+			_mm256_extracti128_si256(li, 1));
+	__m128i s16 = _mm_packus_epi32(_mm256_castsi256_si128(si),
+			_mm256_extracti128_si256(si, 1));
+	_mm_storel_epi64((__m128i*) lig, _mm_packus_epi16(l16, l16));
+	_mm_storel_epi64((__m128i*) sat, _mm_packus_epi16(s16, s16));
+}
+
+__attribute__((target("avx2")))
+void LigSatRedAVX2(const uchar* bgr, uchar* lig, uchar* sat, uchar* red,
+		int len) {
+	uchar masks[3][3][16];
+	__m256i m[3][3];
+	for (int c = 0; c < 3; c++) {
+		DeinterleaveMasks(c, masks[c]);
+		for (int k = 0; k < 3; k++) {
+			m[c][k] = _mm256_broadcastsi128_si256(
+					_mm_loadu_si128((const __m128i*) masks[c][k]));
+		}
+	}
+	alignas(32) uchar vmax[32];
+	alignas(32) uchar vmin[32];
+	int i = 0;
+	for (; i + 32 <= len; i += 32) {
+		const uchar* s = bgr + i * 3;
+		__m256i v[3] = { LoadLanesAVX2(s), LoadLanesAVX2(s + 16), LoadLanesAVX2(
+				s + 32) };
+		__m256i ch[3];
+		for (int c = 0; c < 3; c++) {
+			ch[c] = _mm256_or_si256(
+					_mm256_or_si256(_mm256_shuffle_epi8(v[0], m[c][0]),
+							_mm256_shuffle_epi8(v[1], m[c][1])),
+					_mm256_shuffle_epi8(v[2], m[c][2]));
+		}
+		if (red) {
+			_mm256_storeu_si256((__m256i*) (red + i), ch[2]);
+		}
+		_mm256_store_si256((__m256i*) vmax,
+				_mm256_max_epu8(_mm256_max_epu8(ch[0], ch[1]), ch[2]));
+		_mm256_store_si256((__m256i*) vmin,
+				_mm256_min_epu8(_mm256_min_epu8(ch[0], ch[1]), ch[2]));
+		for (int j = 0; j < 32; j += 8) {
+			LigSatAVX2(_mm_loadl_epi64((const __m128i*) (vmax + j)),
+					_mm_loadl_epi64((const __m128i*) (vmin + j)), lig + i + j,
+					sat + i + j);
+		}
+	}
+	LigSatRedSSE42(bgr + i * 3, lig + i, sat + i, red ? red + i : nullptr,
+			len - i);
+}
+
+__attribute__((target("avx2")))
+void RemapAVX2(const uchar* src, size_t step, int rows, int cols,
+		const short* xy, const ushort* a, uchar* dst, int len) {
+	// Eight pixels per iteration, the four neighbours are gathered as
+	// dwords, so the block must lie inside the image one pixel short of the
+	// right edge; blocks touching the border take the scalar path
+	const __m256i tab = _mm256_set1_epi32(REMAP_TAB);
+	const __m256i round = _mm256_set1_epi32(1 << (REMAP_SHIFT - 1));
+	const __m256i byteMask = _mm256_set1_epi32(0xff);
+	const __m256i pack = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i*) PACK_RGB));
+	const __m256i packIdx = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+	const __m256i storeMask = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+	const __m256i xMax = _mm256_set1_epi32(cols - 2);
+	const __m256i yMax = _mm256_set1_epi32(rows - 1);
+	const __m256i minus1 = _mm256_set1_epi32(-1);
+	const __m256i vStep = _mm256_set1_epi32((int) step);
+	int i = 0;
+	for (; i + 8 <= len; i += 8) {
+		__m256i vxy = _mm256_loadu_si256((const __m256i*) (xy + i * 2));
+		__m256i sx = _mm256_srai_epi32(_mm256_slli_epi32(vxy, 16), 16);
+		__m256i sy = _mm256_srai_epi32(vxy, 16);
+		__m256i in = _mm256_and_si256(
+				_mm256_and_si256(_mm256_cmpgt_epi32(sx, minus1),
+						_mm256_cmpgt_epi32(xMax, sx)),
+				_mm256_and_si256(_mm256_cmpgt_epi32(sy, minus1),
+						_mm256_cmpgt_epi32(yMax, sy)));
+		if (_mm256_movemask_epi8(in) != -1) {
+			RemapScalar(src, step, rows, cols, xy + i * 2, a + i, dst + i * 3,
+					8);
+			continue;
+		}
+		__m256i va = _mm256_cvtepu16_epi32(
+				_mm_loadu_si128((const __m128i*) (a + i)));
+		__m256i fx = _mm256_and_si256(va, _mm256_set1_epi32(REMAP_TAB - 1));
+		__m256i fy = _mm256_srli_epi32(va, REMAP_BITS);
+		__m256i gx = _mm256_sub_epi32(tab, fx);
+		__m256i gy = _mm256_sub_epi32(tab, fy);
+		__m256i w00 = _mm256_mullo_epi32(gx, gy);
+		__m256i w01 = _mm256_mullo_epi32(fx, gy);
+		__m256i w10 = _mm256_mullo_epi32(gx, fy);
+		__m256i w11 = _mm256_mullo_epi32(fx, fy);
+		__m256i off = _mm256_add_epi32(_mm256_mullo_epi32(sy, vStep),
+				_mm256_add_epi32(sx, _mm256_add_epi32(sx, sx)));
+		const int* base = (const int*) src;
+		__m256i p00 = _mm256_i32gather_epi32(base, off, 1);
+		__m256i p01 = _mm256_i32gather_epi32(base,
+				_mm256_add_epi32(off, _mm256_set1_epi32(3)), 1);
+		__m256i p10 = _mm256_i32gather_epi32(base,
+				_mm256_add_epi32(off, vStep), 1);
+		__m256i p11 = _mm256_i32gather_epi32(base,
+				_mm256_add_epi32(off, _mm256_add_epi32(vStep,
+						_mm256_set1_epi32(3))), 1);
+		__m256i res = _mm256_setzero_si256();
+		for (int c = 0; c < 3; c++) {
+			__m256i sum = _mm256_add_epi32(round,
+					_mm256_mullo_epi32(w00,
+							_mm256_and_si256(_mm256_srli_epi32(p00, 8 * c),
+									byteMask)));
+			sum = _mm256_add_epi32(sum,
+					_mm256_mullo_epi32(w01,
+							_mm256_and_si256(_mm256_srli_epi32(p01, 8 * c),
+									byteMask)));
+			sum = _mm256_add_epi32(sum,
+					_mm256_mullo_epi32(w10,
+							_mm256_and_si256(_mm256_srli_epi32(p10, 8 * c),
+									byteMask)));
+			sum = _mm256_add_epi32(sum,
+					_mm256_mullo_epi32(w11,
+							_mm256_and_si256(_mm256_srli_epi32(p11, 8 * c),
+									byteMask)));
+			res = _mm256_or_si256(res,
+					_mm256_slli_epi32(_mm256_srli_epi32(sum, REMAP_SHIFT),
+							8 * c));
+		}
+		res = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(res, pack),
+				packIdx);
+		_mm256_maskstore_epi32((int*) (dst + i * 3), storeMask, res);
+	}
+	RemapScalar(src, step, rows, cols, xy + i * 2, a + i, dst + i * 3,
+			len - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline __m512i LoadLanesAVX512(const uchar* s) {
+	__m512i v = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*) s));
+	v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*) (s + 48)), 1);
+	v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*) (s + 96)), 2);
+	return _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*) (s + 144)),
+			3);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void ExtractChannelAVX512(const uchar* src, int channel, uchar* dst,
+		int len) {
+	uchar masks[3][16];
+	DeinterleaveMasks(channel, masks);
+	__m512i m0 = _mm512_broadcast_i32x4(
+			_mm_loadu_si128((const __m128i*) masks[0]));
+	__m512i m1 = _mm512_broadcast_i32x4(
+			_mm_loadu_si128((const __m128i*) masks[1]));
+	__m512i m2 = _mm512_broadcast_i32x4(
+			_mm_loadu_si128((const __m128i*) masks[2]));
+	int i = 0;
+	for (; i + 64 <= len; i += 64) {
+		const uchar* s = src + i * 3;
+		__m512i r = _mm512_or_si512(
+				_mm512_or_si512(_mm512_shuffle_epi8(LoadLanesAVX512(s), m0),
+						_mm512_shuffle_epi8(LoadLanesAVX512(s + 16), m1)),
+				_mm512_shuffle_epi8(LoadLanesAVX512(s + 32), m2));
+		_mm512_storeu_si512((void*) (dst + i), r);
+	}
+	ExtractChannelAVX2(src + i * 3, channel, dst + i, len - i);
+}
+
+// Sixteen lightness and saturation values from sixteen vmax, vmin bytes
+__attribute__((target("avx512f,avx512bw")))
+inline void LigSatAVX512(__m128i vmax, __m128i vmin, uchar* lig, uchar* sat) {
+	const __m512 k = _mm512_set1_ps(1.f / 255);
+	__m512 fmax = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(vmax)),
+			k);
+	__m512 fmin = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(vmin)),
+			k);
+	__m512 sum = _mm512_add_ps(fmax, fmin);
+	__m512 diff = _mm512_sub_ps(fmax, fmin);
+	__m512 l = _mm512_mul_ps(sum, _mm512_set1_ps(0.5f));
+	__m512 den = _mm512_mask_blend_ps(
+			_mm512_cmp_ps_mask(l, _mm512_set1_ps(0.5f), _CMP_LT_OQ),
+			_mm512_sub_ps(_mm512_sub_ps(_mm512_set1_ps(2.f), fmax), fmin), sum);
+	__m512 s = _mm512_maskz_div_ps(
+			_mm512_cmp_ps_mask(diff, _mm512_set1_ps(FLT_EPSILON), _CMP_GT_OQ),
+			diff, den);
+	_mm_storeu_si128((__m128i*) lig,
+			_mm512_cvtusepi32_epi8(
+					_mm512_cvtps_epi32(_mm512_mul_ps(l, _mm512_set1_ps(255.f)))));
+	_mm_storeu_si128((__m128i*) sat,
+			_mm512_cvtusepi32_epi8(
+					_mm512_cvtps_epi32(_mm512_mul_ps(s, _mm512_set1_ps(255.f)))));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void LigSatRedAVX512(const uchar* bgr, uchar* lig, uchar* sat, uchar* red,
+		int len) {
+	uchar masks[3][3][16];
+	__m512i m[3][3];
+	for (int c = 0; c < 3; c++) {
+		DeinterleaveMasks(c, masks[c]);
+		for (int k = 0; k < 3; k++) {
+			m[c][k] = _mm512_broadcast_i32x4(
+					_mm_loadu_si128((const __m128i*) masks[c][k]));
+		}
+	}
+	int i = 0;
+	for (; i + 64 <= len; i += 64) {
+		const uchar* s = bgr + i * 3;
+		__m512i v[3] = { LoadLanesAVX512(s), LoadLanesAVX512(s + 16),
+				LoadLanesAVX512(s + 32) };
+		__m512i ch[3];
+		for (int c = 0; c < 3; c++) {
+			ch[c] = _mm512_or_si512(
+					_mm512_or_si512(_mm512_shuffle_epi8(v[0], m[c][0]),
+							_mm512_shuffle_epi8(v[1], m[c][1])),
+					_mm512_shuffle_epi8(v[2], m[c][2]));
+		}
+		if (red) {
+			_mm512_storeu_si512((void*) (red + i), ch[2]);
+		}
+		__m512i vmax = _mm512_max_epu8(_mm512_max_epu8(ch[0], ch[1]), ch[2]);
+		__m512i vmin = _mm512_min_epu8(_mm512_min_epu8(ch[0], ch[1]), ch[2]);
+		LigSatAVX512(_mm512_extracti32x4_epi32(vmax, 0),
+				_mm512_extracti32x4_epi32(vmin, 0), lig + i, sat + i);
+		LigSatAVX512(_mm512_extracti32x4_epi32(vmax, 1),
+				_mm512_extracti32x4_epi32(vmin, 1), lig + i + 16, sat + i + 16);
+		LigSatAVX512(_mm512_extracti32x4_epi32(vmax, 2),
+				_mm512_extracti32x4_epi32(vmin, 2), lig + i + 32, sat + i + 32);
+		LigSatAVX512(_mm512_extracti32x4_epi32(vmax, 3),
+				_mm512_extracti32x4_epi32(vmin, 3), lig + i + 48, sat + i + 48);
+	}
+	LigSatRedAVX2(bgr + i * 3, lig + i, sat + i, red ? red + i : nullptr,
+			len - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void InRangeAVX512(const uchar* src, uchar lowerb, uchar upperb, uchar* dst,
+		int len) {
+	__m512i lo = _mm512_set1_epi8((char) lowerb);
+	__m512i hi = _mm512_set1_epi8((char) upperb);
+	int i = 0;
+	for (; i + 64 <= len; i += 64) {
+		__m512i v = _mm512_loadu_si512((const void*) (src + i));
+		__mmask64 m = _mm512_cmpge_epu8_mask(v, lo)
+				& _mm512_cmple_epu8_mask(v, hi);
+		_mm512_storeu_si512((void*) (dst + i), _mm512_movm_epi8(m));
+	}
+	InRangeAVX2(src + i, lowerb, upperb, dst + i, len - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void InRangeBitsAVX512(const uchar* src, uchar lowerb, uchar upperb,
+		uchar* dst, int len) {
+	__m512i lo = _mm512_set1_epi8((char) lowerb);
+	__m512i hi = _mm512_set1_epi8((char) upperb);
+	int i = 0;
+	for (; i + 64 <= len; i += 64) {
+		__m512i v = _mm512_loadu_si512((const void*) (src + i));
+		uint64_t bits = _mm512_cmpge_epu8_mask(v, lo)
+				& _mm512_cmple_epu8_mask(v, hi);
+		memcpy(dst + (i >> 3), &bits, sizeof(bits));
+	}
+	InRangeBitsAVX2(src + i, lowerb, upperb, dst + (i >> 3), len - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void PackMaskAVX512(const uchar* src, uchar* dst, int len) {
+	int i = 0;
+	for (; i + 64 <= len; i += 64) {
+		__m512i v = _mm512_loadu_si512((const void*) (src + i));
+		uint64_t bits = _mm512_test_epi8_mask(v, v);
+		memcpy(dst + (i >> 3), &bits, sizeof(bits));
+	}
+	PackMaskAVX2(src + i, dst + (i >> 3), len - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void CombMaskAVX512(const uchar* sat, const uchar* sobelx, const uchar* red,
+		uchar* dst, int len) {
+	int i = 0;
+	for (; i + 64 <= len; i += 64) {
+		__m512i s = _mm512_loadu_si512((const void*) (sat + i));
+		__m512i g = _mm512_loadu_si512((const void*) (sobelx + i));
+		__m512i r = _mm512_loadu_si512((const void*) (red + i));
+		// s | (g & r)
+		_mm512_storeu_si512((void*) (dst + i),
+				_mm512_ternarylogic_epi32(s, g, r, 0xf8));
+	}
+	CombMaskAVX2(sat + i, sobelx + i, red + i, dst + i, len - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline uint32_t AbsInRangeAVX512(__m512i v, __m512i lo, __m512i hi) {
+	v = _mm512_abs_epi16(v);
+	return _mm512_cmpge_epi16_mask(v, lo) & _mm512_cmple_epi16_mask(v, hi);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void AbsInRangeBitsAVX512(const short* src, short lowerb, short upperb,
+		uchar* dst, int len) {
+	__m512i lo = _mm512_set1_epi16(lowerb);
+	__m512i hi = _mm512_set1_epi16(upperb);
+	int i = 0;
+	for (; i + 32 <= len; i += 32) {
+		uint32_t bits = AbsInRangeAVX512(
+				_mm512_loadu_si512((const void*) (src + i)), lo, hi);
+		memcpy(dst + (i >> 3), &bits, sizeof(bits));
+	}
+	AbsInRangeBitsAVX2(src + i, lowerb, upperb, dst + (i >> 3), len - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline __m512i SobelxAVX512(const uchar* r0, const uchar* r1,
+		const uchar* r2, int x) {
+	auto diff = [x](const uchar* r) {
+		return _mm512_sub_epi16(
+				_mm512_cvtepu8_epi16(
+						_mm256_loadu_si256((const __m256i*) (r + x + 1))),
+				_mm512_cvtepu8_epi16(
+						_mm256_loadu_si256((const __m256i*) (r + x - 1))));
+	};
+	__m512i d1 = diff(r1);
+	return _mm512_add_epi16(_mm512_add_epi16(diff(r0), diff(r2)),
+			_mm512_add_epi16(d1, d1));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void SobelxThreshBitsAVX512(const uchar* r0, const uchar* r1,
+		const uchar* r2, short lowerb, short upperb, uchar* dst, int len) {
+	__m512i lo = _mm512_set1_epi16(lowerb);
+	__m512i hi = _mm512_set1_epi16(upperb);
+	int i = std::min(32, len);
+	SobelxThreshBitsRange(r0, r1, r2, lowerb, upperb, dst, len, 0, i);
+	for (; i + 33 <= len; i += 32) {
+		uint32_t bits = AbsInRangeAVX512(SobelxAVX512(r0, r1, r2, i), lo, hi);
+		memcpy(dst + (i >> 3), &bits, sizeof(bits));
+	}
+	SobelxThreshBitsRange(r0, r1, r2, lowerb, upperb, dst, len, i, len);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void RemapAVX512(const uchar* src, size_t step, int rows, int cols,
+		const short* xy, const ushort* a, uchar* dst, int len) {
+	// Sixteen pixels per iteration, same scheme as the AVX2 kernel
+	const __m512i tab = _mm512_set1_epi32(REMAP_TAB);
+	const __m512i round = _mm512_set1_epi32(1 << (REMAP_SHIFT - 1));
+	const __m512i byteMask = _mm512_set1_epi32(0xff);
+	const __m512i pack = _mm512_broadcast_i32x4(
+			_mm_loadu_si128((const __m128i*) PACK_RGB));
+	const __m512i packIdx = _mm512_setr_epi32(0, 1, 2, 4, 5, 6, 8, 9, 10, 12,
+			13, 14, 3, 7, 11, 15);
+	const __m512i xMax = _mm512_set1_epi32(cols - 2);
+	const __m512i yMax = _mm512_set1_epi32(rows - 1);
+	const __m512i zero = _mm512_setzero_si512();
+	const __m512i vStep = _mm512_set1_epi32((int) step);
+	int i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m512i vxy = _mm512_loadu_si512((const void*) (xy + i * 2));
+		__m512i sx = _mm512_srai_epi32(_mm512_slli_epi32(vxy, 16), 16);
+		__m512i sy = _mm512_srai_epi32(vxy, 16);
+		__mmask16 in = _mm512_cmpge_epi32_mask(sx, zero)
+				& _mm512_cmplt_epi32_mask(sx, xMax)
+				& _mm512_cmpge_epi32_mask(sy, zero)
+				& _mm512_cmplt_epi32_mask(sy, yMax);
+		if (in != 0xffff) {
+			RemapScalar(src, step, rows, cols, xy + i * 2, a + i, dst + i * 3,
+					16);
+			continue;
+		}
+		__m512i va = _mm512_cvtepu16_epi32(
+				_mm256_loadu_si256((const __m256i*) (a + i)));
+		__m512i fx = _mm512_and_si512(va, _mm512_set1_epi32(REMAP_TAB - 1));
+		__m512i fy = _mm512_srli_epi32(va, REMAP_BITS);
+		__m512i gx = _mm512_sub_epi32(tab, fx);
+		__m512i gy = _mm512_sub_epi32(tab, fy);
+		__m512i w00 = _mm512_mullo_epi32(gx, gy);
+		__m512i w01 = _mm512_mullo_epi32(fx, gy);
+		__m512i w10 = _mm512_mullo_epi32(gx, fy);
+		__m512i w11 = _mm512_mullo_epi32(fx, fy);
+		__m512i off = _mm512_add_epi32(_mm512_mullo_epi32(sy, vStep),
+				_mm512_add_epi32(sx, _mm512_add_epi32(sx, sx)));
+		__m512i p00 = _mm512_i32gather_epi32(off, src, 1);
+		__m512i p01 = _mm512_i32gather_epi32(
+				_mm512_add_epi32(off, _mm512_set1_epi32(3)), src, 1);
+		__m512i p10 = _mm512_i32gather_epi32(_mm512_add_epi32(off, vStep),
+				src, 1);
+		__m512i p11 = _mm512_i32gather_epi32(
+				_mm512_add_epi32(off,
+						_mm512_add_epi32(vStep, _mm512_set1_epi32(3))), src,
+				1);
+		__m512i res = _mm512_setzero_si512();
+		for (int c = 0; c < 3; c++) {
+			__m512i sum = _mm512_add_epi32(round,
+					_mm512_mullo_epi32(w00,
+							_mm512_and_si512(_mm512_srli_epi32(p00, 8 * c),
+									byteMask)));
+			sum = _mm512_add_epi32(sum,
+					_mm512_mullo_epi32(w01,
+							_mm512_and_si512(_mm512_srli_epi32(p01, 8 * c),
+									byteMask)));
+			sum = _mm512_add_epi32(sum,
+					_mm512_mullo_epi32(w10,
+							_mm512_and_si512(_mm512_srli_epi32(p10, 8 * c),
+									byteMask)));
+			sum = _mm512_add_epi32(sum,
+					_mm512_mullo_epi32(w11,
+							_mm512_and_si512(_mm512_srli_epi32(p11, 8 * c),
+									byteMask)));
+			res = _mm512_or_si512(res,
+					_mm512_slli_epi32(_mm512_srli_epi32(sum, REMAP_SHIFT),
+							8 * c));
+		}
+		res = _mm512_permutexvar_epi32(packIdx,
+				_mm512_shuffle_epi8(res, pack));
+		_mm512_mask_storeu_epi32((void*) (dst + i * 3), 0x0fff, res);
+	}
+	RemapAVX2(src, step, rows, cols, xy + i * 2, a + i, dst + i * 3, len - i);
+}
+
+#endif
+
+const SimdKernels::Table TABLES[] = {
+		{ ExtractChannelScalar, LigSatRedScalar, InRangeScalar,
+				InRangeBitsScalar, PackMaskScalar, CombMaskScalar,
+				AbsInRangeBitsScalar, SobelxThreshBitsScalar, RemapScalar },
+#if defined(__x86_64__) || defined(__i386__)
+		// No gather before AVX2, the warp kernel stays scalar
+		{ ExtractChannelSSE42, LigSatRedSSE42, InRangeSSE42, InRangeBitsSSE42,
+				PackMaskSSE42, CombMaskSSE42, AbsInRangeBitsSSE42,
+				SobelxThreshBitsSSE42, RemapScalar }, { ExtractChannelAVX2,
+				LigSatRedAVX2, InRangeAVX2, InRangeBitsAVX2, PackMaskAVX2,
+				CombMaskAVX2, AbsInRangeBitsAVX2, SobelxThreshBitsAVX2,
+				RemapAVX2 }, { ExtractChannelAVX512, LigSatRedAVX512,
+				InRangeAVX512, InRangeBitsAVX512, PackMaskAVX512,
+				CombMaskAVX512, AbsInRangeBitsAVX512, SobelxThreshBitsAVX512,
+				RemapAVX512 },
+#endif
+		};
+
+SimdKernels::ISA DetectIsa() {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+		return SimdKernels::ISA_AVX512;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		return SimdKernels::ISA_AVX2;
+	}
+	if (__builtin_cpu_supports("sse4.2")) {
+		return SimdKernels::ISA_SSE42;
+	}
+#endif
+	return SimdKernels::ISA_SCALAR;
+}
+
+}
+
+SimdKernels::SimdKernels(ISA isa) :
+		isa(isa), table(TABLES[isa]) {
+	PRINT_DEBUG_MSG(DEBUG_ZONE_LANE_BASE, "SimdKernels, using %s kernels\n",
+			getName());
+}
+
+const SimdKernels& SimdKernels::Get() {
+	static const SimdKernels kernels(DetectIsa());
+	return kernels;
+}
+
+const SimdKernels::Table* SimdKernels::getTable(ISA isa) {
+	int n = sizeof(TABLES) / sizeof(TABLES[0]);
+	return (isa < n && isa <= DetectIsa()) ? &TABLES[isa] : nullptr;
+}
+
+const char* SimdKernels::getName() const {
+	switch (isa) {
+	case ISA_SSE42:
+		return "SSE4.2";
+	case ISA_AVX2:
+		return "AVX2";
+	case ISA_AVX512:
+		return "AVX-512";
+	default:
+		return "scalar";
+	}
+}
+
+void SimdKernels::ExtractChannel(const cv::Mat &src, int channel,
+		cv::Mat &dst) const {
+	CV_Assert(src.type() == CV_8UC3 && channel >= 0 && channel < 3);
+	dst.create(src.size(), CV_8UC1);
+	for (int y = 0; y < src.rows; y++) {
+		table.extractChannel(src.ptr<uchar>(y), channel, dst.ptr<uchar>(y),
+				src.cols);
+	}
+}
+
+void SimdKernels::LigSat(const cv::Mat &bgr, cv::Mat &lig,
+		cv::Mat &sat) const {
+	CV_Assert(bgr.type() == CV_8UC3);
+	lig.create(bgr.size(), CV_8UC1);
+	sat.create(bgr.size(), CV_8UC1);
+	for (int y = 0; y < bgr.rows; y++) {
+		table.ligSatRed(bgr.ptr<uchar>(y), lig.ptr<uchar>(y), sat.ptr<uchar>(y),
+				nullptr, bgr.cols);
+	}
+}
+
+void SimdKernels::LigSatRed(const cv::Mat &bgr, cv::Mat &lig, cv::Mat &sat,
+		cv::Mat &red) const {
+	CV_Assert(bgr.type() == CV_8UC3);
+	lig.create(bgr.size(), CV_8UC1);
+	sat.create(bgr.size(), CV_8UC1);
+	red.create(bgr.size(), CV_8UC1);
+	for (int y = 0; y < bgr.rows; y++) {
+		table.ligSatRed(bgr.ptr<uchar>(y), lig.ptr<uchar>(y), sat.ptr<uchar>(y),
+				red.ptr<uchar>(y), bgr.cols);
+	}
+}
+
+void SimdKernels::InRange(const cv::Mat &src, int lowerb, int upperb,
+		cv::Mat &dst) const {
+	CV_Assert(src.type() == CV_8UC1);
+	dst.create(src.size(), CV_8UC1);
+	// Bounds outside 0..255 clamp, an empty range gives an empty mask
+	if (lowerb > upperb || lowerb > 255 || upperb < 0) {
+		dst.setTo(cv::Scalar::all(0));
+		return;
+	}
+	uchar lo = cv::saturate_cast<uchar>(lowerb);
+	uchar hi = cv::saturate_cast<uchar>(upperb);
+	for (int y = 0; y < src.rows; y++) {
+		table.inRange(src.ptr<uchar>(y), lo, hi, dst.ptr<uchar>(y), src.cols);
+	}
+}
+
+void SimdKernels::InRangeBits(const cv::Mat &src, int lowerb, int upperb,
+		BitMask &dst) const {
+	CV_Assert(src.type() == CV_8UC1);
+	dst.create(src.size());
+	if (lowerb > upperb || lowerb > 255 || upperb < 0) {
+		return;
+	}
+	uchar lo = cv::saturate_cast<uchar>(lowerb);
+	uchar hi = cv::saturate_cast<uchar>(upperb);
+	for (int y = 0; y < src.rows; y++) {
+		table.inRangeBits(src.ptr<uchar>(y), lo, hi, (uchar*) dst.row(y),
+				src.cols);
+	}
+}
+
+void SimdKernels::AbsInRangeBits(const cv::Mat &src, int lowerb, int upperb,
+		BitMask &dst) const {
+	CV_Assert(src.type() == CV_16SC1);
+	dst.create(src.size());
+	if (lowerb > upperb || upperb < 0) {
+		return;
+	}
+	short lo = cv::saturate_cast<short>(std::max(lowerb, 0));
+	short hi = cv::saturate_cast<short>(upperb);
+	for (int y = 0; y < src.rows; y++) {
+		table.absInRangeBits(src.ptr<short>(y), lo, hi, (uchar*) dst.row(y),
+				src.cols);
+	}
+}
+
+void SimdKernels::SobelxThreshBits(const cv::Mat &src, int lowerb, int upperb,
+		BitMask &dst) const {
+	CV_Assert(src.type() == CV_8UC1);
+	dst.create(src.size());
+	if (lowerb > upperb || upperb < 0) {
+		return;
+	}
+	short lo = cv::saturate_cast<short>(std::max(lowerb, 0));
+	short hi = cv::saturate_cast<short>(upperb);
+	int last = src.rows - 1;
+	for (int y = 0; y < src.rows; y++) {
+		// Rows -1 and rows reflect like the default border
+		int y0 = y > 0 ? y - 1 : std::min(1, last);
+		int y2 = y < last ? y + 1 : std::max(last - 1, 0);
+		table.sobelxThreshBits(src.ptr<uchar>(y0), src.ptr<uchar>(y),
+				src.ptr<uchar>(y2), lo, hi, (uchar*) dst.row(y), src.cols);
+	}
+}
+
+void SimdKernels::CombMask(const cv::Mat &sat, const cv::Mat &sobelx,
+		const cv::Mat &red, cv::Mat &dst) const {
+	CV_Assert(sat.type() == CV_8UC1 && sobelx.size() == sat.size()
+			&& red.size() == sat.size());
+	dst.create(sat.size(), CV_8UC1);
+	for (int y = 0; y < sat.rows; y++) {
+		table.combMask(sat.ptr<uchar>(y), sobelx.ptr<uchar>(y),
+				red.ptr<uchar>(y), dst.ptr<uchar>(y), sat.cols);
+	}
+}
+
+void SimdKernels::Remap(const cv::Mat &src, const cv::Mat &xy,
+		const cv::Mat &a, cv::Mat &dst) const {
+	CV_Assert(src.type() == CV_8UC3 && xy.type() == CV_16SC2
+			&& a.type() == CV_16UC1 && a.size() == xy.size());
+	dst.create(xy.size(), CV_8UC3);
+	for (int y = 0; y < xy.rows; y++) {
+		table.remap(src.ptr<uchar>(), src.step, src.rows, src.cols,
+				xy.ptr<short>(y), a.ptr<ushort>(y), dst.ptr<uchar>(y),
+				xy.cols);
+	}
+}
@@ -0,0 +1,51 @@
+#include "lane_following/step_graph.h"
+
+void StepGraph::Add(int procStep, uint64_t deps) {
+	Node node;
+	node.procStep = procStep;
+	node.deps = deps;
+	nodes.push_back(node);
+}
+
+bool StepGraph::isDone() const {
+	for (const Node &node : nodes) {
+		if (!(done & Bit(node.procStep))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void StepGraph::Start(CompletedItemList &items, bool bParallel,
+		int &procStep) {
+	done = 0;
+	items.clear();
+	Issue(items, bParallel, procStep);
+}
+
+void StepGraph::Next(CompletedItemList &items, bool bParallel,
+		int &procStep) {
+	for (const CompletedItem &item : items) {
+		if (item.taskState == TASK_STATE_COMPLETED) {
+			done |= Bit(item.procStep);
+		}
+	}
+	items.rmCompleted();
+	Issue(items, bParallel, procStep);
+}
+
+void StepGraph::Issue(CompletedItemList &items, bool bParallel,
+		int &procStep) {
+	for (const Node &node : nodes) {
+		if (!bParallel && !items.empty()) {
+			return;
+		}
+		uint64_t bit = Bit(node.procStep);
+		if ((done & bit) || (node.deps & ~done)
+				|| items.contains(node.procStep)) {
+			continue;
+		}
+		items.addItem(node.procStep, TASK_STATE_INITIALIZED);
+		procStep = node.procStep;
+	}
+}
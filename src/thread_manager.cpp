@@ -19,11 +19,13 @@
 #include <set>
 #include <numeric>
 
+#include "lane_following/calibration.h"
 #include "lane_following/color_grad_thresh.h"
 #include "lane_following/completed_item.h"
 #include "lane_following/cuda_color_grad_thresh.h"
 #include "lane_following/cuda_warp.h"
 #include "lane_following/lane_base.h"
+#include "lane_following/thresh_controller.h"
 #include "lane_following/warp.h"
 
 template class ThreadManager<CudaWarp, CudaColorGradThresh, FindLanes> ;
@@ -55,6 +57,9 @@ ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::ThreadManager(tm_args *args)
 	frameDuration = 1000000;
 	procDuration = 0;
 	lastAngle = 0.5;
+	trackedCnt = 0;
+	warmupMisses = 0;
+	frameArena.Attach( { &frameImg });
 
 	threadManager = this;
 
@@ -103,15 +108,17 @@ void ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::Start() {
 					cv::Size(frameImg.cols, frameImg.rows));
 #endif
 		}
+		WarpGeometry geometry =
+				args.geometry.Resolve(frameImg.size()).getFull();
 		laneHistory.leftLine.found = true;
 		laneHistory.rightLine.found = true;
 		laneHistory.leftLine.xBase = 0;
-		laneHistory.rightLine.xBase = frameImg.cols;
+		laneHistory.rightLine.xBase = geometry.width;
 		laneHistory.leftLine.fit = {0,0,0};
 		laneHistory.rightLine.fit = {0,0,0};
 		laneHistory.leftLine.angle = 0;
 		laneHistory.rightLine.angle = 0;
-		laneHistory.laneWidth = frameImg.cols / 2;
+		laneHistory.laneWidth = geometry.scaleX * frameImg.cols / 2;
 
 		frameEndTime = std::chrono::high_resolution_clock::now();
 		warpEndTime = std::chrono::high_resolution_clock::now();
@@ -148,13 +155,16 @@ void ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::GetNextFrame() {
 	while (zedImg.empty() && !ros::isShuttingDown()) {
 		ros::spinOnce();
 	}
-	frameImg = zedImg.clone();
+	// Ownership moves to the pipeline, the callback writes a new image
+	frameImg = zedImg;
 	zedImg.release();
 	//imshow("FrameImg", frameImg);
 	//cv::waitKey(1);
 	//imwrite( "/home/nvidia/temp_imgs/frame_img.jpg", frameImg );
 #else
 	if (videoCap.isOpened()) {
+		// Warp still holds the previous frame, capture into a new buffer
+		frameImg.release();
 		videoCap >> frameImg;
 		if (frameImg.empty())
 			PRINT_DEBUG_MSG(DEBUG_ZONE_ERROR,
@@ -279,9 +289,9 @@ void ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::CompleteTask(
 
 	for (int i = 0; i < args.pipelineInstNum; i++) {
 
-		// If all step tasks are completed
+		// If any step task completed, it may unblock the steps reading it
 		if (!obj[i]->completedItemList.empty()
-				&& obj[i]->completedItemList.isCompleted()) {
+				&& obj[i]->completedItemList.hasCompleted()) {
 
 			int old_procStep = obj[i]->getProcStep();
 			CompletedItemList old_completedItemList = obj[i]->completedItemList;
@@ -393,6 +403,9 @@ void ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::CompleteTask(
 								std::chrono::microseconds>(
 								frameStartTime - frameEndTime).count();
 						frameDurations.push_back(frameDuration);
+						if (frameDurations.size() == ALLOC_WARMUP_FRAMES) {
+							warmupMisses = getArenaMisses();
+						}
 						frameEndTime = frameStartTime;
 						speeds.push_back(temp_findLanes->getMaxSpeed());
 						startTask = true;
@@ -410,6 +423,10 @@ void ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::CompleteTask(
 							laneHistory = temp_findLanes->getLaneHistory();
 							ShowFrame(temp_findLanes->getOutImg());
 						}
+						trackedCnt = (temp_findLanes->isDetected()
+								&& laneHistory.leftLine.found
+								&& laneHistory.rightLine.found) ?
+								trackedCnt + 1 : 0;
 #if DEBUG_ZONE_ROS
 						MotorPublisher(args.speed, lastAngle);
 #endif
@@ -440,7 +457,7 @@ void ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::CompleteTask(
 			}
 #if 1
 			else {
-				// If findLanes procStep is second to last
+				// If findLanes just queued the steering step
 				std::shared_ptr<FIND_LANES> temp_findLanes =
 						std::dynamic_pointer_cast<FIND_LANES>(obj[i]);
 				if (temp_findLanes
@@ -617,6 +634,9 @@ bool ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::StartColorGradThresh(
 	bool ret = false;
 	for (int i = 0; (i < args.pipelineInstNum) && warp; i++) {
 		if (colorGradThresh[i]->completedItemList.empty()) {
+			// Lanes of the last finished frame, until tracking is lost
+			colorGradThresh[i]->setLanePrior(trackedCnt >= PRIOR_MIN_TRACKED,
+					laneHistory.leftLine.fit, laneHistory.rightLine.fit);
 			colorGradThresh[i]->setParams(warp.get());
 #if 0
 			for (auto &it : colorGradThresh[i]->completedItemList) {
@@ -649,6 +669,8 @@ bool ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::StartFindLanes(
 		if (findLanes[i]->completedItemList.empty()) {
 			findLanes[i]->setFrameDuration(frameDuration);
 			findLanes[i]->setSpeed(args.speed);
+			findLanes[i]->setLanePrior(trackedCnt >= PRIOR_MIN_TRACKED,
+					laneHistory.leftLine.fit, laneHistory.rightLine.fit);
 			findLanes[i]->setParams(colorGradThresh.get());
 #if 0
 			for (auto &it : findLanes[i]->completedItemList) {
@@ -830,7 +852,22 @@ void ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::ProcessMsg(
 
 template<typename WARP, typename COLOR_GRAD_THRESH, typename FIND_LANES>
 bool ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::PreWorkInit() {
+	// Camera calibration, compiled-in defaults without a file
+	Calibration calibration;
+	if (!calibration.Load(args.calibFile)) {
+		PRINT_DEBUG_MSG(DEBUG_ZONE_THREAD_MANAGER,
+				"[%ld]ThreadManager::PreWorkInit, no calibration in %s, using defaults\n",
+				GetThreadId(), args.calibFile.c_str());
+	}
+	// The CUDA warp has no remap tables, say so instead of dropping the
+	// option silently
+	if (args.bRemap && args.bGpuAccel) {
+		PRINT_DEBUG_MSG(DEBUG_ZONE_ERROR,
+				"[%ld]ThreadManager::PreWorkInit warning: bRemap is CPU only, ignored with bGpuAccel\n",
+				GetThreadId());
+	}
 	// Create module instances
+	std::shared_ptr<ThreshController> threshController;
 	for (int i = 0; i < args.pipelineInstNum; i++) {
 		warp[i] = std::make_shared<WARP>(i, args.bParallel, args.bGpuAccel,
 				args.bVerbose);
@@ -838,6 +875,40 @@ bool ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::PreWorkInit() {
 				args.bParallel, args.bGpuAccel, args.bVerbose);
 		findLanes[i] = std::make_shared<FIND_LANES>(i, args.bParallel,
 				args.bGpuAccel, args.bVerbose);
+		warp[i]->setRemap((args.bRemap || args.bFused) && !args.bGpuAccel);
+		warp[i]->setCalibration(calibration);
+		warp[i]->setMapCacheFile(args.mapCacheFile);
+		warp[i]->setGeometry(args.geometry);
+		warp[i]->setFused(args.bFused && !args.bGpuAccel);
+		warp[i]->setSparse(args.bSparse && !args.bGpuAccel);
+		// Split the warp over the workers left to this instance. Bands are
+		// always queued together, sequential mode included, that is where
+		// a single frame's latency matters most
+		warp[i]->setBandsNum(
+				(!args.bGpuAccel && !args.bFused && !args.bSparse) ?
+						args.threadPoolSize / args.pipelineInstNum : 1);
+		colorGradThresh[i]->setFused(args.bFused && !args.bGpuAccel);
+		colorGradThresh[i]->setSparse(args.bSparse && !args.bGpuAccel);
+		colorGradThresh[i]->setColorLut(args.bColorLut && !args.bGpuAccel);
+		colorGradThresh[i]->setPriorBands(
+				args.bPriorBands && !args.bGpuAccel && !args.bSparse);
+		colorGradThresh[i]->setGradNorm(args.bGradNorm);
+		// One controller for all instances, frames feed it in turn
+		if (args.pixelBudget > 0) {
+			if (!threshController) {
+				threshController = std::make_shared<ThreshController>(
+						colorGradThresh[i]->getThresholds(), args.pixelBudget);
+			}
+			colorGradThresh[i]->setThreshController(threshController);
+		}
+		// Same split for the threshold chain, halos keep bands independent
+		colorGradThresh[i]->setBandsNum(
+				(!args.bGpuAccel && !args.bSparse) ?
+						args.threadPoolSize / args.pipelineInstNum : 1);
+		findLanes[i]->setRefine(args.bPyramidRefine);
+		findLanes[i]->setPrefixSearch(args.bPrefixSearch);
+		findLanes[i]->setDualSearch(args.bDualSearch);
+		findLanes[i]->setPriorSearch(args.bPriorSearch);
 
 		PRINT_DEBUG_MSG(DEBUG_ZONE_THREAD_MANAGER,
 				"[%ld]ThreadManager::PreWorkInit, warp[%d]=%p\n", GetThreadId(),
@@ -934,6 +1005,31 @@ long int ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::getAvgDuration() {
 	return res;
 }
 
+template<typename WARP, typename COLOR_GRAD_THRESH, typename FIND_LANES>
+uint64_t ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::getArenaMisses() {
+	uint64_t res = frameArena.getMisses();
+	for (int i = 0; i < args.pipelineInstNum; i++) {
+		if (warp[i]) {
+			res += warp[i]->getArena().getMisses();
+		}
+		if (colorGradThresh[i]) {
+			res += colorGradThresh[i]->getArena().getMisses();
+		}
+		if (findLanes[i]) {
+			res += findLanes[i]->getArena().getMisses();
+		}
+	}
+	return res;
+}
+
+template<typename WARP, typename COLOR_GRAD_THRESH, typename FIND_LANES>
+uint64_t ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::getSteadyArenaMisses() {
+	if (frameDurations.size() < ALLOC_WARMUP_FRAMES) {
+		return 0;
+	}
+	return getArenaMisses() - warmupMisses;
+}
+
 template<typename WARP, typename COLOR_GRAD_THRESH, typename FIND_LANES>
 double ThreadManager<WARP, COLOR_GRAD_THRESH, FIND_LANES>::getAvgSpeed() {
 	double res = 0;
@@ -0,0 +1,58 @@
+#include "lane_following/thresh_controller.h"
+
+#include <algorithm>
+
+#include "lane_following/debug.h"
+
+ThreshController::ThreshController(
+		const ColorGradThreshBase::Thresholds &base, int pixelBudget) :
+		base(base), thresh(base), pixelBudget(pixelBudget) {
+}
+
+ColorGradThreshBase::Thresholds ThreshController::getThresholds() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return thresh;
+}
+
+void ThreshController::Update(const ColorGradThreshBase::Histograms &hist,
+		int pixels) {
+	std::lock_guard<std::mutex> guard(lock);
+	if (pixels > pixelBudget) {
+		double share = (double) pixelBudget / pixels;
+		Tighten(hist.red, base.red[0], thresh.red, share);
+		Tighten(hist.sat, base.sat[0], thresh.sat, share);
+		Tighten(hist.sobelx, base.sobelx[0], thresh.sobelx, share);
+	} else if (pixels * 100 < pixelBudget * RELAX_PCT) {
+		Relax(base.red[0], thresh.red);
+		Relax(base.sat[0], thresh.sat);
+		Relax(base.sobelx[0], thresh.sobelx);
+	}
+	PRINT_DEBUG_MSG(DEBUG_ZONE_COLOR_GRAD_THRESH,
+			"ThreshController::Update, pixels = %d, red = %d, sat = %d, sobelx = %d\n",
+			pixels, thresh.red[0], thresh.sat[0], thresh.sobelx[0]);
+}
+
+void ThreshController::Tighten(const int hist[256], int baseLo, int range[2],
+		double share) {
+	int passing = 0;
+	for (int v = range[0]; v <= range[1] && v < 256; v++) {
+		passing += hist[v];
+	}
+	if (passing == 0) {
+		return;
+	}
+	// Lowest bound that passes at most share of the sampled pixels
+	int target = (int) (passing * share);
+	int lo = range[0];
+	while (lo < range[1] && passing > target) {
+		passing -= hist[lo++];
+	}
+	int step = std::max((lo - range[0]) * GAIN_PCT / 100, 1);
+	range[0] = std::max(std::min(range[0] + step, range[1]), baseLo);
+}
+
+void ThreshController::Relax(int baseLo, int range[2]) {
+	if (range[0] > baseLo) {
+		range[0] -= std::max((range[0] - baseLo) / RELAX_DIV, 1);
+	}
+}
@@ -0,0 +1,240 @@
+#include "lane_following/warp_maps.h"
+
+#include <opencv2/core/hal/interface.h>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "lane_following/debug.h"
+
+std::map<WarpMaps::Key, std::shared_ptr<const WarpMaps>> WarpMaps::cache;
+std::mutex WarpMaps::cacheLock;
+
+WarpMaps::WarpMaps() :
+		mapAddr(nullptr), mapLen(0) {
+}
+
+WarpMaps::WarpMaps(const cv::Point2f src[4], const cv::Point2f dst[4],
+		const WarpGeometry& geometry) :
+		size(geometry.getBand().size()), mapAddr(nullptr), mapLen(0) {
+	perspTf = getPerspectiveTransform(src, dst);
+	invPerspTf = getPerspectiveTransform(dst, src);
+	// Maps cover the lane band only, warpPerspective samples the source
+	// through the inverted matrix
+	cv::Mat shift = cv::Mat::eye(3, 3, CV_64F);
+	shift.at<double>(0, 2) = -geometry.margin;
+	cv::Mat bandPerspTf = shift * perspTf;
+	Build(bandPerspTf.inv(), geometry);
+}
+
+WarpMaps::~WarpMaps() {
+	if (mapAddr) {
+		munmap(mapAddr, mapLen);
+	}
+}
+
+std::shared_ptr<const WarpMaps> WarpMaps::Get(const Key& key,
+		const cv::Point2f src[4], const cv::Point2f dst[4],
+		const WarpGeometry& geometry, const std::string& cacheFile) {
+	std::lock_guard<std::mutex> lock(cacheLock);
+	auto it = cache.find(key);
+	if (it != cache.end()) {
+		return it->second;
+	}
+	std::shared_ptr<const WarpMaps> maps;
+	std::string fileName =
+			cacheFile.empty() ? cacheFile : getCacheFileName(cacheFile, key);
+	if (!fileName.empty()) {
+		maps = Map(fileName, key);
+	}
+	if (!maps) {
+		cv::Rect band = geometry.getBand();
+		PRINT_DEBUG_MSG(DEBUG_ZONE_WARP, "WarpMaps::Get, building maps %dX%d\n",
+				band.height, band.width);
+		maps = std::make_shared<WarpMaps>(src, dst, geometry);
+		if (!fileName.empty() && !maps->Save(fileName, key)) {
+			PRINT_DEBUG_MSG(DEBUG_ZONE_ERROR,
+					"WarpMaps::Get error: failed writing %s\n",
+					fileName.c_str());
+		}
+	}
+	cache[key] = maps;
+	return maps;
+}
+
+uint64_t WarpMaps::Key::Hash() const {
+	// FNV-1a
+	const int64_t fields[] = { frameWidth, frameHeight, (int64_t) calibHash,
+			width, height, margin, farUniformRows, farOutRows };
+	uint64_t hash = 14695981039346656037ULL;
+	for (int64_t field : fields) {
+		for (unsigned i = 0; i < sizeof(field); i++) {
+			hash ^= (uint8_t) (field >> (8 * i));
+			hash *= 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
+std::string WarpMaps::getCacheFileName(const std::string& cacheFile,
+		const Key& key) {
+	// warp_maps.bin -> warp_maps.<key hash>.bin, every layout keeps its own
+	// file and alternating layouts do not rebuild each other's maps
+	char hash[17];
+	snprintf(hash, sizeof(hash), "%016llx", (unsigned long long) key.Hash());
+	size_t dot = cacheFile.rfind('.');
+	size_t slash = cacheFile.rfind('/');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)
+			|| dot == slash + 1) {
+		return cacheFile + "." + hash;
+	}
+	return cacheFile.substr(0, dot) + "." + hash + cacheFile.substr(dot);
+}
+
+std::shared_ptr<const WarpMaps> WarpMaps::Map(const std::string& fileName,
+		const Key& key) {
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return nullptr;
+	}
+	struct stat st;
+	void* addr = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(CacheHeader)) {
+		addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (addr == MAP_FAILED) {
+		return nullptr;
+	}
+	std::shared_ptr<WarpMaps> maps(new WarpMaps());
+	maps->mapAddr = addr;
+	maps->mapLen = st.st_size;
+
+	// Stale cache: other camera, calibration or layout
+	const CacheHeader* header = (const CacheHeader*) addr;
+	bool bValid = header->magic == CACHE_MAGIC
+			&& header->version == CACHE_VERSION
+			&& header->frameWidth == key.frameWidth
+			&& header->frameHeight == key.frameHeight
+			&& header->calibHash == key.calibHash && header->width == key.width
+			&& header->height == key.height && header->margin == key.margin
+			&& header->farUniformRows == key.farUniformRows
+			&& header->farOutRows == key.farOutRows;
+	if (bValid) {
+		maps->size = cv::Size(key.width - 2 * key.margin, key.height);
+		bValid = maps->mapLen
+				== sizeof(CacheHeader)
+						+ (size_t) maps->size.area()
+								* (sizeof(short) * 2 + sizeof(ushort));
+	}
+	if (!bValid) {
+		PRINT_DEBUG_MSG(DEBUG_ZONE_WARP,
+				"WarpMaps::Map, %s does not match, rebuilding\n",
+				fileName.c_str());
+		return nullptr;
+	}
+
+	// Read-only views of the mapping, nothing is copied
+	uchar* data = (uchar*) addr + sizeof(CacheHeader);
+	maps->perspTf = cv::Mat(3, 3, CV_64F, (void*) header->perspTf);
+	maps->invPerspTf = cv::Mat(3, 3, CV_64F, (void*) header->invPerspTf);
+	maps->xy = cv::Mat(maps->size, CV_16SC2, data);
+	maps->a = cv::Mat(maps->size, CV_16UC1,
+			data + (size_t) maps->size.area() * sizeof(short) * 2);
+	PRINT_DEBUG_MSG(DEBUG_ZONE_WARP, "WarpMaps::Map, mapped %s\n",
+			fileName.c_str());
+	return maps;
+}
+
+bool WarpMaps::Save(const std::string& fileName, const Key& key) const {
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.frameWidth = key.frameWidth;
+	header.frameHeight = key.frameHeight;
+	header.width = key.width;
+	header.height = key.height;
+	header.margin = key.margin;
+	header.farUniformRows = key.farUniformRows;
+	header.farOutRows = key.farOutRows;
+	header.calibHash = key.calibHash;
+	memcpy(header.perspTf, perspTf.ptr<double>(), sizeof(header.perspTf));
+	memcpy(header.invPerspTf, invPerspTf.ptr<double>(),
+			sizeof(header.invPerspTf));
+
+	// Write aside under a unique name and rename, a concurrent start never
+	// maps a partial file and concurrent writers never share the temporary.
+	// Only a fully written and closed file is renamed into place.
+	std::string tmpName = fileName + ".XXXXXX";
+	int fd = mkstemp(&tmpName[0]);
+	if (fd < 0) {
+		return false;
+	}
+	fchmod(fd, 0644);
+	struct {
+		const void* data;
+		size_t len;
+	} parts[] = { { &header, sizeof(header) }, { xy.ptr(), xy.total()
+			* xy.elemSize() }, { a.ptr(), a.total() * a.elemSize() } };
+	bool bWritten = true;
+	for (auto &part : parts) {
+		const char* p = (const char*) part.data;
+		size_t left = part.len;
+		while (bWritten && left > 0) {
+			ssize_t n = write(fd, p, left);
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			bWritten = n > 0;
+			p += bWritten ? n : 0;
+			left -= bWritten ? n : 0;
+		}
+	}
+	bWritten = close(fd) == 0 && bWritten;
+	if (!bWritten || std::rename(tmpName.c_str(), fileName.c_str()) != 0) {
+		unlink(tmpName.c_str());
+		return false;
+	}
+	return true;
+}
+
+void WarpMaps::Build(const cv::Mat& invPerspTf,
+		const WarpGeometry& geometry) {
+	// Same fixed-point rounding as warpPerspective, so remap() reproduces it.
+	// Output rows sample the uniform layout through the row profile.
+	const double* M = invPerspTf.ptr<double>();
+	xy.create(size, CV_16SC2);
+	a.create(size, CV_16UC1);
+	for (int y = 0; y < size.height; y++) {
+		short* pxy = xy.ptr<short>(y);
+		ushort* pa = a.ptr<ushort>(y);
+		double v = geometry.RowToUniform(y);
+		double X0 = M[1] * v + M[2];
+		double Y0 = M[4] * v + M[5];
+		double W0 = M[7] * v + M[8];
+		for (int x = 0; x < size.width; x++) {
+			double W = W0 + M[6] * x;
+			W = W ? cv::INTER_TAB_SIZE / W : 0;
+			double fX = std::max((double) INT_MIN,
+					std::min((double) INT_MAX, (X0 + M[0] * x) * W));
+			double fY = std::max((double) INT_MIN,
+					std::min((double) INT_MAX, (Y0 + M[3] * x) * W));
+			int X = cv::saturate_cast<int>(fX);
+			int Y = cv::saturate_cast<int>(fY);
+			pxy[x * 2] = cv::saturate_cast<short>(X >> cv::INTER_BITS);
+			pxy[x * 2 + 1] = cv::saturate_cast<short>(Y >> cv::INTER_BITS);
+			pa[x] = (ushort) ((Y & (cv::INTER_TAB_SIZE - 1)) * cv::INTER_TAB_SIZE
+					+ (X & (cv::INTER_TAB_SIZE - 1)));
+		}
+	}
+}
@@ -0,0 +1,14 @@
+#ifndef TEST_TEST_H_
+#define TEST_TEST_H_
+
+#include <cstdio>
+
+// Each test is a program of its own that returns the number of failed
+// checks, failures are printed as they happen
+static int testFailures = 0;
+
+#define CHECK(x, ...) if (!(x)) { testFailures++; \
+	printf("%s:%d: check failed: %s, ", __FILE__, __LINE__, #x); \
+	printf(__VA_ARGS__); printf("\n"); }
+
+#endif /* TEST_TEST_H_ */
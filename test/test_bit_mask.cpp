@@ -0,0 +1,99 @@
+#include <opencv2/core.hpp>
+#include <cstdlib>
+
+#include "lane_following/bit_mask.h"
+#include "test.h"
+
+namespace {
+
+// Sparse 8-bit mask with arbitrary non-zero values, not only 255
+cv::Mat RandomMask(cv::Size size) {
+	cv::Mat m(size, CV_8UC1);
+	for (int y = 0; y < m.rows; y++) {
+		for (int x = 0; x < m.cols; x++) {
+			m.at<uchar>(y, x) = (rand() % 3) ? 0 : 1 + rand() % 255;
+		}
+	}
+	return m;
+}
+
+// 255 where src is non-zero
+cv::Mat Binary(const cv::Mat &src) {
+	cv::Mat dst(src.size(), CV_8UC1);
+	for (int y = 0; y < src.rows; y++) {
+		for (int x = 0; x < src.cols; x++) {
+			dst.at<uchar>(y, x) = src.at<uchar>(y, x) ? 255 : 0;
+		}
+	}
+	return dst;
+}
+
+bool Same(const cv::Mat &a, const cv::Mat &b) {
+	return a.size() == b.size() && a.type() == b.type()
+			&& cv::countNonZero(a != b) == 0;
+}
+
+// Padding bits past cols must stay clear, CountNonZero counts whole words
+bool PaddingClear(const BitMask &m) {
+	int cols = m.size().width;
+	for (int y = 0; y < m.size().height; y++) {
+		const uint64_t* w = m.row(y);
+		for (int x = cols; x < m.getWordsPerRow() * 64; x++) {
+			if ((w[x >> 6] >> (x & 63)) & 1) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+}
+
+int main() {
+	srand(1);
+	// Widths around word boundaries and the SIMD block sizes
+	int widths[] = { 1, 7, 63, 64, 65, 127, 128, 200, 257, 1280 };
+	for (int w : widths) {
+		cv::Size size(w, 1 + rand() % 9);
+		// ROIs of a wider mask, rows are not contiguous
+		cv::Mat big = RandomMask(cv::Size(w + 5, size.height));
+		cv::Mat sat = big(cv::Rect(3, 0, w, size.height));
+		cv::Mat sobelx = RandomMask(size);
+		cv::Mat red = RandomMask(size);
+
+		BitMask bSat, bSobelx, bRed, comb;
+		bSat.Pack(sat);
+		bSobelx.Pack(sobelx);
+		bRed.Pack(red);
+		cv::Mat unpacked;
+		bSat.Unpack(unpacked);
+		CHECK(Same(unpacked, Binary(sat)), "Pack / Unpack, width %d", w);
+		CHECK(PaddingClear(bSat), "padding bits set, width %d", w);
+		CHECK(bSat.CountNonZero() == cv::countNonZero(sat),
+				"CountNonZero %d, expected %d, width %d", bSat.CountNonZero(),
+				cv::countNonZero(sat), w);
+
+		BitMask::Comb(bSat, bSobelx, bRed, comb);
+		comb.Unpack(unpacked);
+		CHECK(Same(unpacked, Binary(sat) | (Binary(sobelx) & Binary(red))),
+				"Comb, width %d", w);
+
+		// Row ranges packed separately add up to the whole mask, create
+		// clears a mask it reuses
+		BitMask rows;
+		rows.Pack(sobelx);
+		rows.create(size);
+		CHECK(rows.CountNonZero() == 0, "create left bits set, width %d", w);
+		int mid = size.height / 2;
+		rows.PackRows(sat, cv::Range(mid, size.height));
+		rows.PackRows(sat, cv::Range(0, mid));
+		rows.Unpack(unpacked);
+		CHECK(Same(unpacked, Binary(sat)), "PackRows, width %d", w);
+
+		BitMask swapped;
+		swapped.swap(rows);
+		CHECK(rows.empty() && swapped.size() == size, "swap, width %d", w);
+	}
+	printf("%d failures\n", testFailures);
+	return testFailures;
+}
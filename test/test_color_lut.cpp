@@ -0,0 +1,70 @@
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cstdlib>
+
+#include "lane_following/color_lut.h"
+#include "lane_following/simd_kernels.h"
+#include "test.h"
+
+namespace {
+
+bool Same(const cv::Mat &a, const cv::Mat &b) {
+	return a.size() == b.size() && a.type() == b.type()
+			&& cv::countNonZero(a != b) == 0;
+}
+
+// Table lookups against the direct path, LigSatRed followed by InRange
+void CompareDirect(const ColorLut &lut, const int red[2], const int sat[2],
+		const cv::Mat &bgr) {
+	const SimdKernels &kernels = SimdKernels::Get();
+	cv::Mat lig, satMask, redMask, refLig, refSat, refRed;
+	lut.Apply(bgr, lig, satMask, redMask);
+	kernels.LigSatRed(bgr, refLig, refSat, refRed);
+	kernels.InRange(refSat, sat[0], sat[1], refSat);
+	kernels.InRange(refRed, red[0], red[1], refRed);
+	CHECK(Same(lig, refLig), "lightness, red %d-%d sat %d-%d", red[0],
+			red[1], sat[0], sat[1]);
+	CHECK(Same(satMask, refSat), "saturation mask, red %d-%d sat %d-%d",
+			red[0], red[1], sat[0], sat[1]);
+	CHECK(Same(redMask, refRed), "red mask, red %d-%d sat %d-%d", red[0],
+			red[1], sat[0], sat[1]);
+}
+
+}
+
+int main() {
+	srand(1);
+	// Every (max, min) pair with the maximum in each channel, then random
+	// pixels through an ROI
+	cv::Mat pairs(256 * 3, 256, CV_8UC3);
+	for (int y = 0; y < pairs.rows; y++) {
+		uchar* p = pairs.ptr<uchar>(y);
+		for (int x = 0; x < pairs.cols; x++, p += 3) {
+			int vmax = y % 256;
+			int c = y / 256;
+			p[c] = vmax;
+			p[(c + 1) % 3] = std::min(x, vmax);
+			p[(c + 2) % 3] = (vmax + std::min(x, vmax) + 1) / 2;
+		}
+	}
+	cv::Mat noise(67, 129, CV_8UC3);
+	for (size_t i = 0; i < noise.total() * 3; i++) {
+		noise.ptr<uchar>()[i] = rand() & 255;
+	}
+	cv::Mat roi = noise(cv::Rect(1, 2, 121, 60));
+
+	int thresholds[][4] = { { 220, 255, 90, 255 }, { 0, 255, 0, 255 }, { 100,
+			50, 30, 20 }, { 255, 255, 0, 0 }, { -10, 300, 120, 180 } };
+	for (auto &t : thresholds) {
+		int red[2] = { t[0], t[1] };
+		int sat[2] = { t[2], t[3] };
+		std::shared_ptr<const ColorLut> lut = ColorLut::Get(red, sat);
+		CompareDirect(*lut, red, sat, pairs);
+		CompareDirect(*lut, red, sat, roi);
+		CHECK(ColorLut::Get(red, sat) == lut,
+				"table of red %d-%d sat %d-%d not cached", red[0], red[1],
+				sat[0], sat[1]);
+	}
+	printf("%d failures\n", testFailures);
+	return testFailures;
+}
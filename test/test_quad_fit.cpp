@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include "lane_following/quad_fit.h"
+#include "test.h"
+
+namespace {
+
+enum {
+	HEIGHT = 720,
+	TRIALS = 20000
+};
+
+// Largest difference from the reference fit allowed, in pixels
+const double MAX_ERROR = 1e-3;
+
+double Uniform(double lo, double hi) {
+	return lo + (hi - lo) * rand() / RAND_MAX;
+}
+
+// Least squares in uncentred y, Gaussian elimination of the normal
+// equations with partial pivoting in long double
+void ReferenceFit(const std::vector<double> &xs, const std::vector<double> &ys,
+		long double e[3]) {
+	long double m[3][4] = { };
+	for (size_t i = 0; i < xs.size(); i++) {
+		long double v[3] = { (long double) ys[i] * ys[i], ys[i], 1 };
+		for (int r = 0; r < 3; r++) {
+			for (int c = 0; c < 3; c++) {
+				m[r][c] += v[r] * v[c];
+			}
+			m[r][3] += v[r] * xs[i];
+		}
+	}
+	for (int i = 0; i < 3; i++) {
+		int p = i;
+		for (int j = i + 1; j < 3; j++) {
+			if (std::fabs(m[j][i]) > std::fabs(m[p][i])) {
+				p = j;
+			}
+		}
+		for (int c = 0; c < 4; c++) {
+			std::swap(m[i][c], m[p][c]);
+		}
+		for (int j = i + 1; j < 3; j++) {
+			long double f = m[j][i] / m[i][i];
+			for (int c = i; c < 4; c++) {
+				m[j][c] -= f * m[i][c];
+			}
+		}
+	}
+	for (int i = 2; i >= 0; i--) {
+		long double v = m[i][3];
+		for (int k = i + 1; k < 3; k++) {
+			v -= m[i][k] * e[k];
+		}
+		e[i] = v / m[i][i];
+	}
+}
+
+double Eval(const std::vector<float> &fit, double y) {
+	return (fit[0] * y + fit[1]) * y + fit[2];
+}
+
+// Fit of the points against the reference at the given rows, returns the
+// largest difference
+double FitError(const std::vector<double> &xs, const std::vector<double> &ys,
+		const std::vector<int> &rows) {
+	QuadFit q;
+	q.setRange(0, HEIGHT - 1);
+	for (size_t i = 0; i < xs.size(); i++) {
+		q.Add(xs[i], ys[i]);
+	}
+	CHECK(q.size() == (int) xs.size(), "%d points added, %d counted",
+			(int) xs.size(), q.size());
+	std::vector<float> fit;
+	q.Solve(fit);
+	long double e[3];
+	ReferenceFit(xs, ys, e);
+	double err = 0;
+	for (int y : rows) {
+		long double ref = (e[0] * y + e[1]) * y + e[2];
+		err = std::max(err, (double) std::fabs(Eval(fit, y) - ref));
+	}
+	return err;
+}
+
+// One integer point per found window, lane x = a y^2 + b y + c plus noise,
+// windows counted up from the bottom of the frame
+void LanePoints(int windows, int found, double noise, std::vector<double> &xs,
+		std::vector<double> &ys) {
+	double a = Uniform(-6e-4, 6e-4);
+	double b = Uniform(-1, 1);
+	double c = Uniform(150, 1130);
+	double winH = (double) HEIGHT / windows;
+	xs.clear();
+	ys.clear();
+	for (int k = 0; k < found; k++) {
+		int lo = (int) (HEIGHT - (k + 1) * winH);
+		int hi = (int) (HEIGHT - k * winH);
+		int y = lo + rand() % (hi - lo);
+		xs.push_back((int) (a * y * y + b * y + c + Uniform(-noise, noise)));
+		ys.push_back(y);
+	}
+}
+
+}
+
+int main() {
+	srand(1);
+	// Every row of the frame
+	std::vector<int> allRows;
+	for (int y = 0; y < HEIGHT; y++) {
+		allRows.push_back(y);
+	}
+
+	// Window search results, 4 to 32 windows found out of 32. With 4 the
+	// points are bunched in the bottom eighth and the fit reaches the top
+	// by extrapolation
+	std::vector<double> xs, ys;
+	double maxErr = 0;
+	for (int t = 0; t < TRIALS; t++) {
+		LanePoints(32, 4 + rand() % 29, 4, xs, ys);
+		maxErr = std::max(maxErr, FitError(xs, ys, allRows));
+	}
+	CHECK(maxErr <= MAX_ERROR, "lane fits off the reference by %g px",
+			maxErr);
+
+	// Fewer than three distinct y, the mean and then a line
+	QuadFit q;
+	q.setRange(0, HEIGHT - 1);
+	std::vector<float> fit;
+	q.Solve(fit);
+	CHECK(fit.size() == 3 && fit[0] == 0 && fit[1] == 0 && fit[2] == 0,
+			"empty fit %g %g %g", fit[0], fit[1], fit[2]);
+	q.Add(100, 500);
+	q.Add(110, 500);
+	q.Solve(fit);
+	CHECK(fit[0] == 0 && fit[1] == 0 && std::fabs(fit[2] - 105) < MAX_ERROR,
+			"one row fit %g %g %g", fit[0], fit[1], fit[2]);
+	q.Add(130, 600);
+	q.Add(140, 600);
+	q.Solve(fit);
+	CHECK(fit[0] == 0 && std::fabs(Eval(fit, 500) - 105) < MAX_ERROR
+			&& std::fabs(Eval(fit, 600) - 135) < MAX_ERROR,
+			"two row fit %g %g %g", fit[0], fit[1], fit[2]);
+	q.clear();
+	CHECK(q.size() == 0, "%d points after clear", q.size());
+	printf("%d failures\n", testFailures);
+	return testFailures;
+}
@@ -0,0 +1,89 @@
+#include <opencv2/core.hpp>
+#include <cstdlib>
+#include <vector>
+
+#include "lane_following/bit_mask.h"
+#include "lane_following/row_index.h"
+#include "test.h"
+
+namespace {
+
+// Mask with about one pixel in density set
+cv::Mat RandomMask(cv::Size size, int density) {
+	cv::Mat m(size, CV_8UC1);
+	for (int y = 0; y < m.rows; y++) {
+		for (int x = 0; x < m.cols; x++) {
+			m.at<uchar>(y, x) = (rand() % density) ? 0 : 255;
+		}
+	}
+	return m;
+}
+
+// The index against a scan of the mask, row by row
+void Compare(const RowIndex &index, const cv::Mat &mask, int histRow,
+		const std::vector<int> &hist, const char* name) {
+	CHECK(index.getRows() == mask.rows, "%s %d rows, mask %d", name,
+			index.getRows(), mask.rows);
+	std::vector<int> refHist(mask.cols, 0);
+	int total = 0;
+	for (int y = 0; y < mask.rows; y++) {
+		std::vector<short> ref;
+		for (int x = 0; x < mask.cols; x++) {
+			if (mask.at<uchar>(y, x)) {
+				ref.push_back(x);
+				if (y >= histRow) {
+					refHist[x]++;
+				}
+			}
+		}
+		total += ref.size();
+		std::vector<short> xs(index.begin(y), index.end(y));
+		CHECK(xs == ref, "%s row %d of %dx%d, %d pixels, %d expected", name,
+				y, mask.cols, mask.rows, (int) xs.size(), (int) ref.size());
+	}
+	CHECK(index.size() == total, "%s %d pixels, %d expected", name,
+			index.size(), total);
+	CHECK(hist == refHist, "%s histogram from row %d of %dx%d", name,
+			histRow, mask.cols, mask.rows);
+}
+
+}
+
+int main() {
+	srand(1);
+	// One index reused across sizes, as frames reuse it
+	RowIndex bitIndex, ptIndex;
+	std::vector<int> hist;
+	int widths[] = { 1, 63, 64, 65, 130, 640 };
+	int densities[] = { 1, 2, 7, 50, 1000 };
+	for (int round = 0; round < 200; round++) {
+		cv::Size size(widths[rand() % 6], 1 + rand() % 70);
+		cv::Mat mask = RandomMask(size, densities[rand() % 5]);
+		int histRow = rand() % (size.height + 1);
+
+		BitMask bits;
+		bits.Pack(mask);
+		bitIndex.Build(bits, histRow, hist);
+		Compare(bitIndex, mask, histRow, hist, "mask");
+
+		// Bottom-up and right to left within a row, as sparse thresholding
+		// delivers them
+		std::vector<cv::Point> pts;
+		for (int y = size.height - 1; y >= 0; y--) {
+			for (int x = size.width - 1; x >= 0; x--) {
+				if (mask.at<uchar>(y, x)) {
+					pts.push_back(cv::Point(x, y));
+				}
+			}
+		}
+		ptIndex.Build(pts, size, histRow, hist);
+		Compare(ptIndex, mask, histRow, hist, "points");
+	}
+
+	bitIndex.clear();
+	CHECK(bitIndex.getRows() == 0 && bitIndex.size() == 0,
+			"cleared index has %d rows, %d pixels", bitIndex.getRows(),
+			bitIndex.size());
+	printf("%d failures\n", testFailures);
+	return testFailures;
+}
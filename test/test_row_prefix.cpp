@@ -0,0 +1,100 @@
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "lane_following/bit_mask.h"
+#include "lane_following/row_index.h"
+#include "lane_following/row_prefix.h"
+#include "test.h"
+
+namespace {
+
+// Mask with about one pixel in density set
+cv::Mat RandomMask(cv::Size size, int density) {
+	cv::Mat m(size, CV_8UC1);
+	for (int y = 0; y < m.rows; y++) {
+		for (int x = 0; x < m.cols; x++) {
+			m.at<uchar>(y, x) = (rand() % density) ? 0 : 255;
+		}
+	}
+	return m;
+}
+
+// Random range reaching past both ends of 0..n, sometimes empty or
+// reversed
+cv::Range RandomRange(int n) {
+	int a = rand() % (n + 20) - 10;
+	int b = rand() % (n + 20) - 10;
+	return (rand() % 8) ? cv::Range(std::min(a, b), std::max(a, b)) :
+			cv::Range(a, b);
+}
+
+// Window sums of both builds against a loop over the clipped rectangle
+void CompareWindows(const RowPrefix &fromMask, const RowPrefix &fromIndex,
+		const cv::Mat &mask) {
+	for (int i = 0; i < 200; i++) {
+		cv::Range rows = RandomRange(mask.rows);
+		cv::Range cols = RandomRange(mask.cols);
+		int refNum = 0, refX = 0, refY = 0;
+		for (int y = std::max(rows.start, 0);
+				y < std::min(rows.end, mask.rows); y++) {
+			for (int x = std::max(cols.start, 0);
+					x < std::min(cols.end, mask.cols); x++) {
+				if (mask.at<uchar>(y, x)) {
+					refNum++;
+					refX += x;
+					refY += y;
+				}
+			}
+		}
+		int num, xSum, ySum;
+		fromMask.Window(rows, cols, num, xSum, ySum);
+		CHECK(num == refNum && xSum == refX && ySum == refY,
+				"mask window rows %d..%d cols %d..%d of %dx%d: %d %d %d, "
+				"expected %d %d %d", rows.start, rows.end, cols.start,
+				cols.end, mask.cols, mask.rows, num, xSum, ySum, refNum, refX,
+				refY);
+		fromIndex.Window(rows, cols, num, xSum, ySum);
+		CHECK(num == refNum && xSum == refX && ySum == refY,
+				"index window rows %d..%d cols %d..%d of %dx%d: %d %d %d, "
+				"expected %d %d %d", rows.start, rows.end, cols.start,
+				cols.end, mask.cols, mask.rows, num, xSum, ySum, refNum, refX,
+				refY);
+	}
+}
+
+}
+
+int main() {
+	srand(1);
+	// Both builds reused across sizes, as frames reuse them
+	RowPrefix fromMask, fromIndex;
+	RowIndex index;
+	std::vector<int> hist, indexHist;
+	int widths[] = { 1, 63, 64, 65, 130, 640 };
+	int densities[] = { 1, 2, 7, 50, 1000 };
+	for (int round = 0; round < 100; round++) {
+		cv::Size size(widths[rand() % 6], 1 + rand() % 70);
+		cv::Mat mask = RandomMask(size, densities[rand() % 5]);
+		int histRow = rand() % (size.height + 1);
+
+		BitMask bits;
+		bits.Pack(mask);
+		fromMask.Build(bits, histRow, hist);
+		index.Build(bits, histRow, indexHist);
+		fromIndex.Build(index, size.width);
+		CHECK(!fromMask.empty() && !fromIndex.empty(), "empty after build");
+		CHECK(hist == indexHist, "histogram from row %d of %dx%d", histRow,
+				size.width, size.height);
+		CompareWindows(fromMask, fromIndex, mask);
+	}
+
+	fromMask.clear();
+	int num, xSum, ySum;
+	fromMask.Window(cv::Range(0, 10), cv::Range(0, 10), num, xSum, ySum);
+	CHECK(fromMask.empty() && num == 0 && xSum == 0 && ySum == 0,
+			"cleared prefix sums give %d %d %d", num, xSum, ySum);
+	printf("%d failures\n", testFailures);
+	return testFailures;
+}
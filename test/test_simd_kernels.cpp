@@ -0,0 +1,265 @@
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "lane_following/bit_mask.h"
+#include "lane_following/simd_kernels.h"
+#include "test.h"
+
+namespace {
+
+enum {
+	ROUNDS = 2000,
+	// Longer than the widest vector body plus its scalar tail
+	MAX_LEN = 300,
+	// Guard bytes past the end of every output row
+	GUARD = 64,
+	REMAP_TAB = 1 << cv::INTER_BITS
+};
+
+// Random bytes, one in four is 0 or 255 so the range ends are hit
+void RandomBytes(uchar* p, int n) {
+	for (int i = 0; i < n; i++) {
+		p[i] = (rand() % 4) ? rand() & 255 : ((rand() & 1) ? 255 : 0);
+	}
+}
+
+// Output rows of the scalar and the tested variant, prefilled alike so a
+// write past len shows as a difference
+struct Rows {
+	std::vector<uchar> ref;
+	std::vector<uchar> out;
+	explicit Rows(int n) :
+			ref(n + GUARD, 0xaa), out(n + GUARD, 0xaa) {
+	}
+	bool same() const {
+		return ref == out;
+	}
+};
+
+void CompareVariant(const SimdKernels::Table &ref,
+		const SimdKernels::Table &t, const char* name) {
+	std::vector<uchar> src[3];
+	std::vector<short> grad(MAX_LEN);
+	for (int k = 0; k < 3; k++) {
+		src[k].resize(MAX_LEN * 3 + 16);
+	}
+	for (int round = 0; round < ROUNDS; round++) {
+		int len = 1 + rand() % MAX_LEN;
+		// Misaligned starts
+		int offset = rand() % 16;
+		for (int k = 0; k < 3; k++) {
+			RandomBytes(src[k].data(), src[k].size());
+		}
+		const uchar* s = src[0].data() + offset;
+		int lo = rand() % 256;
+		int hi = lo + rand() % (257 - lo);
+		int bytes = (len + 7) / 8;
+
+		Rows r(len);
+		int channel = rand() % 3;
+		ref.extractChannel(s, channel, r.ref.data(), len);
+		t.extractChannel(s, channel, r.out.data(), len);
+		CHECK(r.same(), "%s extractChannel, len %d", name, len);
+
+		Rows l(len), sat(len), red(len);
+		ref.ligSatRed(s, l.ref.data(), sat.ref.data(), red.ref.data(), len);
+		t.ligSatRed(s, l.out.data(), sat.out.data(), red.out.data(), len);
+		CHECK(l.same() && sat.same() && red.same(), "%s ligSatRed, len %d",
+				name, len);
+
+		Rows in(len), bits(bytes), packed(bytes), comb(len);
+		ref.inRange(s, lo, hi, in.ref.data(), len);
+		t.inRange(s, lo, hi, in.out.data(), len);
+		CHECK(in.same(), "%s inRange %d..%d, len %d", name, lo, hi, len);
+		ref.inRangeBits(s, lo, hi, bits.ref.data(), len);
+		t.inRangeBits(s, lo, hi, bits.out.data(), len);
+		CHECK(bits.same(), "%s inRangeBits %d..%d, len %d", name, lo, hi,
+				len);
+		ref.packMask(s, packed.ref.data(), len);
+		t.packMask(s, packed.out.data(), len);
+		CHECK(packed.same(), "%s packMask, len %d", name, len);
+		ref.combMask(s, src[1].data(), src[2].data(), comb.ref.data(), len);
+		t.combMask(s, src[1].data(), src[2].data(), comb.out.data(), len);
+		CHECK(comb.same(), "%s combMask, len %d", name, len);
+
+		// Sobel range of 8-bit rows is -1020..1020
+		short glo = rand() % 1100;
+		short ghi = glo + rand() % 1100;
+		for (int i = 0; i < len; i++) {
+			grad[i] = rand() % 2041 - 1020;
+		}
+		Rows absBits(bytes), sobel(bytes);
+		ref.absInRangeBits(grad.data(), glo, ghi, absBits.ref.data(), len);
+		t.absInRangeBits(grad.data(), glo, ghi, absBits.out.data(), len);
+		CHECK(absBits.same(), "%s absInRangeBits %d..%d, len %d", name, glo,
+				ghi, len);
+		ref.sobelxThreshBits(src[0].data(), src[1].data(), src[2].data(), glo,
+				ghi, sobel.ref.data(), len);
+		t.sobelxThreshBits(src[0].data(), src[1].data(), src[2].data(), glo,
+				ghi, sobel.out.data(), len);
+		CHECK(sobel.same(), "%s sobelxThreshBits %d..%d, len %d", name, glo,
+				ghi, len);
+	}
+
+	// Remap from a small image, coordinates reach past every border
+	cv::Mat img(37, 53, CV_8UC3);
+	RandomBytes(img.ptr<uchar>(), img.total() * 3);
+	std::vector<short> xy(MAX_LEN * 2);
+	std::vector<ushort> a(MAX_LEN);
+	for (int round = 0; round < ROUNDS; round++) {
+		int len = 1 + rand() % MAX_LEN;
+		for (int i = 0; i < len; i++) {
+			xy[i * 2] = rand() % (img.cols + 4) - 2;
+			xy[i * 2 + 1] = rand() % (img.rows + 4) - 2;
+			a[i] = rand() % (REMAP_TAB * REMAP_TAB);
+		}
+		Rows r(len * 3);
+		ref.remap(img.ptr<uchar>(), img.step, img.rows, img.cols, xy.data(),
+				a.data(), r.ref.data(), len);
+		t.remap(img.ptr<uchar>(), img.step, img.rows, img.cols, xy.data(),
+				a.data(), r.out.data(), len);
+		CHECK(r.same(), "%s remap, len %d", name, len);
+	}
+}
+
+cv::Mat RandomMat(cv::Size size, int type) {
+	cv::Mat m(size, type);
+	for (int y = 0; y < m.rows; y++) {
+		RandomBytes(m.ptr<uchar>(y), m.cols * m.elemSize());
+	}
+	return m;
+}
+
+bool Same(const cv::Mat &a, const cv::Mat &b) {
+	return a.size() == b.size() && a.type() == b.type()
+			&& cv::countNonZero(a != b) == 0;
+}
+
+// The dispatched kernels against the OpenCV calls they stand in for, on
+// an ROI so rows are not contiguous
+void CompareOpenCV(const SimdKernels &kernels) {
+	cv::Mat bgr = RandomMat(cv::Size(203, 31), CV_8UC3)(
+			cv::Rect(3, 2, 197, 27));
+	cv::Mat gray = RandomMat(cv::Size(203, 31), CV_8UC1)(
+			cv::Rect(3, 2, 197, 27));
+
+	for (int c = 0; c < 3; c++) {
+		cv::Mat dst, ref;
+		kernels.ExtractChannel(bgr, c, dst);
+		cv::extractChannel(bgr, ref, c);
+		CHECK(Same(dst, ref), "ExtractChannel %d", c);
+	}
+
+	BitMask bits;
+	cv::Mat dst, ref, unpacked;
+	int bounds[][2] = { { 0, 255 }, { 30, 200 }, { 200, 30 }, { -5, 300 }, {
+			255, 255 } };
+	for (auto &b : bounds) {
+		cv::inRange(gray, b[0], b[1], ref);
+		kernels.InRange(gray, b[0], b[1], dst);
+		CHECK(Same(dst, ref), "InRange %d..%d", b[0], b[1]);
+		kernels.InRangeBits(gray, b[0], b[1], bits);
+		bits.Unpack(unpacked);
+		CHECK(Same(unpacked, ref), "InRangeBits %d..%d", b[0], b[1]);
+	}
+
+	cv::Mat sobelx, absSobelx;
+	cv::Sobel(gray, sobelx, CV_16S, 1, 0);
+	absSobelx = cv::abs(sobelx);
+	int gradBounds[][2] = { { 0, 1020 }, { 20, 100 }, { 100, 20 }, { 255,
+			SHRT_MAX } };
+	for (auto &b : gradBounds) {
+		cv::inRange(absSobelx, b[0], b[1], ref);
+		kernels.AbsInRangeBits(sobelx, b[0], b[1], bits);
+		bits.Unpack(unpacked);
+		CHECK(Same(unpacked, ref), "AbsInRangeBits %d..%d", b[0], b[1]);
+		kernels.SobelxThreshBits(gray, b[0], b[1], bits);
+		bits.Unpack(unpacked);
+		CHECK(Same(unpacked, ref), "SobelxThreshBits %d..%d", b[0], b[1]);
+	}
+
+	cv::Mat sat = RandomMat(gray.size(), CV_8UC1);
+	cv::Mat red = RandomMat(gray.size(), CV_8UC1);
+	kernels.CombMask(sat, gray, red, dst);
+	CHECK(Same(dst, sat | (gray & red)), "CombMask");
+
+	// Fixed-point maps as WarpMaps stores them, every fraction appears
+	cv::Mat xy(9, 200, CV_16SC2), a(9, 200, CV_16UC1);
+	for (int y = 0; y < xy.rows; y++) {
+		for (int x = 0; x < xy.cols; x++) {
+			xy.at<cv::Vec2s>(y, x) = cv::Vec2s(rand() % (bgr.cols + 4) - 2,
+					rand() % (bgr.rows + 4) - 2);
+			a.at<ushort>(y, x) = (y * xy.cols + x) % (REMAP_TAB * REMAP_TAB);
+		}
+	}
+	kernels.Remap(bgr, xy, a, dst);
+	cv::remap(bgr, ref, xy, a, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+	cv::Mat diff;
+	cv::absdiff(dst, ref, diff);
+	double maxDiff;
+	cv::minMaxLoc(diff.reshape(1), nullptr, &maxDiff);
+	CHECK(maxDiff <= 1, "Remap differs from cv::remap by %g", maxDiff);
+}
+
+// Lightness and saturation depend on the (max, min) channel pair only,
+// every pair against cvtColor(COLOR_BGR2HLS) in every variant
+void CompareHls(const SimdKernels::Table &t, const char* name) {
+	cv::Mat bgr(1, 256 * 257 / 2, CV_8UC3);
+	uchar* p = bgr.ptr<uchar>();
+	for (int vmax = 0; vmax < 256; vmax++) {
+		for (int vmin = 0; vmin <= vmax; vmin++, p += 3) {
+			// Vary the channel holding the maximum
+			int c = (vmax + vmin) % 3;
+			p[c] = vmax;
+			p[(c + 1) % 3] = vmin;
+			p[(c + 2) % 3] = (vmax + vmin) / 2;
+		}
+	}
+	cv::Mat hls, lig(bgr.size(), CV_8UC1), sat(bgr.size(), CV_8UC1);
+	cv::cvtColor(bgr, hls, cv::COLOR_BGR2HLS);
+	t.ligSatRed(bgr.ptr<uchar>(), lig.ptr<uchar>(), sat.ptr<uchar>(),
+			nullptr, bgr.cols);
+	int diffs = 0;
+	for (int x = 0; x < bgr.cols; x++) {
+		const uchar* q = hls.ptr<uchar>() + x * 3;
+		if (lig.at<uchar>(0, x) != q[1] || sat.at<uchar>(0, x) != q[2]) {
+			if (diffs++ < 4) {
+				const uchar* b = bgr.ptr<uchar>() + x * 3;
+				printf("%s: BGR %d %d %d gives L %d S %d, cvtColor %d %d\n",
+						name, b[0], b[1], b[2], lig.at<uchar>(0, x),
+						sat.at<uchar>(0, x), q[1], q[2]);
+			}
+		}
+	}
+	CHECK(diffs == 0, "%s lightness or saturation differs from cvtColor "
+			"for %d pairs", name, diffs);
+}
+
+}
+
+int main() {
+	srand(1);
+	const SimdKernels::Table* scalar = SimdKernels::getTable(
+			SimdKernels::ISA_SCALAR);
+	const SimdKernels::ISA variants[] = { SimdKernels::ISA_SSE42,
+			SimdKernels::ISA_AVX2, SimdKernels::ISA_AVX512 };
+	const char* names[] = { "SSE4.2", "AVX2", "AVX-512" };
+	CompareHls(*scalar, "scalar");
+	for (int i = 0; i < 3; i++) {
+		const SimdKernels::Table* t = SimdKernels::getTable(variants[i]);
+		if (t) {
+			CompareVariant(*scalar, *t, names[i]);
+			CompareHls(*t, names[i]);
+		} else {
+			printf("%s not supported, skipped\n", names[i]);
+		}
+	}
+	CompareOpenCV(SimdKernels::Get());
+	printf("%s kernels, %d failures\n", SimdKernels::Get().getName(),
+			testFailures);
+	return testFailures;
+}
@@ -0,0 +1,145 @@
+#include <cstdlib>
+#include <iterator>
+#include <vector>
+
+#include "lane_following/step_graph.h"
+#include "test.h"
+
+namespace {
+
+typedef StepGraph S;
+
+// Runs a graph to the end the way the manager does: queued items start,
+// one running item completes (the oldest in sequential mode, any in
+// parallel mode) and NextStep retires it. Returns the completion order.
+std::vector<int> Run(StepGraph &graph, const std::vector<uint64_t> &deps,
+		bool bParallel, int maxSteps) {
+	CompletedItemList items;
+	int procStep = -1;
+	uint64_t done = 0;
+	std::vector<int> order;
+	graph.Start(items, bParallel, procStep);
+	while (!items.empty() && (int) order.size() <= maxSteps) {
+		for (CompletedItem &item : items) {
+			CHECK((deps[item.procStep] & ~done) == 0,
+					"step %d queued before its inputs", item.procStep);
+			item.taskState = TASK_STATE_RUNNING;
+		}
+		CHECK(bParallel || items.size() == 1,
+				"%d steps queued in sequential mode", (int) items.size());
+		int pick = bParallel ? rand() % items.size() : 0;
+		auto it = items.begin();
+		std::advance(it, pick);
+		it->taskState = TASK_STATE_COMPLETED;
+		order.push_back(it->procStep);
+		done |= S::Bit(it->procStep);
+		// The manager may restore the list and retry a stalled hand-off,
+		// the retry must not queue anything twice
+		CompletedItemList saved = items;
+		graph.Next(items, bParallel, procStep);
+		if (rand() % 4 == 0) {
+			CompletedItemList retried = saved;
+			graph.Next(retried, bParallel, procStep);
+			CHECK(retried.size() == items.size(),
+					"retry queued %d items, first pass %d",
+					(int) retried.size(), (int) items.size());
+		}
+	}
+	CHECK(graph.isDone(), "graph not done after %d steps",
+			(int) order.size());
+	return order;
+}
+
+enum {
+	SPLIT_BGR,
+	SPLIT_HLS,
+	THRESH_RED,
+	THRESH_SAT,
+	GRAD_THRESH,
+	COMB_THRESH,
+	STEPS
+};
+
+// The staged threshold chain as ColorGradThreshBase declares it
+void AddChain(StepGraph &graph, std::vector<uint64_t> &deps,
+		bool bColorLut) {
+	deps.assign(STEPS, 0);
+	deps[THRESH_RED] = S::Bit(SPLIT_BGR)
+			| (bColorLut ? S::Bit(SPLIT_HLS) : 0);
+	deps[THRESH_SAT] = S::Bit(SPLIT_HLS);
+	deps[GRAD_THRESH] = S::Bit(SPLIT_HLS);
+	deps[COMB_THRESH] = S::Bit(THRESH_RED) | S::Bit(THRESH_SAT)
+			| S::Bit(GRAD_THRESH);
+	for (int step = 0; step < STEPS; step++) {
+		graph.Add(step, deps[step]);
+	}
+}
+
+}
+
+int main() {
+	srand(1);
+	// Sequential mode runs the chain in declaration order, with or without
+	// the color table
+	for (int lut = 0; lut < 2; lut++) {
+		StepGraph graph;
+		std::vector<uint64_t> deps;
+		AddChain(graph, deps, lut);
+		for (int frame = 0; frame < 3; frame++) {
+			std::vector<int> order = Run(graph, deps, false, STEPS);
+			std::vector<int> expected = { SPLIT_BGR, SPLIT_HLS, THRESH_RED,
+					THRESH_SAT, GRAD_THRESH, COMB_THRESH };
+			CHECK(order == expected, "sequential chain order, table %d", lut);
+		}
+	}
+
+	// Parallel mode queues both splits at once, and the three thresholds
+	// together once the splits are done
+	{
+		StepGraph graph;
+		std::vector<uint64_t> deps;
+		AddChain(graph, deps, false);
+		CompletedItemList items;
+		int procStep = -1;
+		graph.Start(items, true, procStep);
+		CHECK(items.size() == 2 && items.contains(SPLIT_BGR)
+				&& items.contains(SPLIT_HLS), "%d steps queued first",
+				(int) items.size());
+		for (CompletedItem &item : items) {
+			item.taskState = TASK_STATE_COMPLETED;
+		}
+		graph.Next(items, true, procStep);
+		CHECK(items.size() == 3 && items.contains(THRESH_RED)
+				&& items.contains(THRESH_SAT)
+				&& items.contains(GRAD_THRESH),
+				"%d steps queued after the splits", (int) items.size());
+	}
+
+	// Random graphs up to the 64 step limit, inputs are earlier steps
+	for (int round = 0; round < 500; round++) {
+		int n = 1 + rand() % 64;
+		StepGraph graph;
+		std::vector<uint64_t> deps(n, 0);
+		for (int step = 0; step < n; step++) {
+			for (int k = 0; k < step; k++) {
+				if (rand() % 8 == 0) {
+					deps[step] |= S::Bit(k);
+				}
+			}
+			graph.Add(step, deps[step]);
+		}
+		bool bParallel = round & 1;
+		std::vector<int> order = Run(graph, deps, bParallel, n);
+		CHECK((int) order.size() == n, "%d of %d steps ran",
+				(int) order.size(), n);
+		if (!bParallel) {
+			// Inputs are earlier steps, so declaration order is always ready
+			for (int i = 0; i < (int) order.size(); i++) {
+				CHECK(order[i] == i, "sequential step %d ran as %d", order[i],
+						i);
+			}
+		}
+	}
+	printf("%d failures\n", testFailures);
+	return testFailures;
+}